@@ -0,0 +1,97 @@
+/*
+    Copyright (c) 2011-2012 Rim Zaidullin <creator@bash.org.ru>
+    Copyright (c) 2011-2012 Other contributors as noted in the AUTHORS file.
+
+    This file is part of Cocaine.
+
+    Cocaine is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Cocaine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>. 
+*/
+
+#ifndef _COCAINE_DEALER_COMPLETION_QUEUE_HPP_INCLUDED_
+#define _COCAINE_DEALER_COMPLETION_QUEUE_HPP_INCLUDED_
+
+#include <string>
+#include <vector>
+
+#include <boost/cstdint.hpp>
+#include <boost/utility.hpp>
+
+#include <cocaine/dealer/forwards.hpp>
+#include <cocaine/dealer/utils/data_container.hpp>
+#include <cocaine/dealer/utils/mpsc_queue.hpp>
+
+namespace cocaine {
+namespace dealer {
+
+enum e_completion_event_type {
+	COMPLETION_EVENT_CHUNK = 1,
+	COMPLETION_EVENT_CHOKE,
+	COMPLETION_EVENT_ERROR
+};
+
+struct completion_event_t {
+	completion_event_t() :
+		type(COMPLETION_EVENT_CHUNK),
+		tag(0),
+		error_code(0) {}
+
+	e_completion_event_type	type;
+
+	// tag given to send_message
+	boost::uint64_t			tag;
+
+	// set for chunk events
+	data_container			data;
+
+	// set for error events
+	int						error_code;
+	std::string				error_message;
+};
+
+// response events of many requests, possibly to different services,
+// gathered in one place, fd() becomes readable when events are pending
+// so the queue can be waited on in a host poll loop
+class completion_queue_t : private boost::noncopyable {
+public:
+	completion_queue_t();
+	virtual ~completion_queue_t();
+
+	// eventfd, readable while there are events to reap
+	int fd() const;
+
+	// appends pending events in arrival order and clears fd readiness,
+	// must be called from one thread at a time
+	size_t reap(std::vector<completion_event_t>& events);
+
+private:
+	friend class dealer_impl_t;
+
+	void push(const completion_event_t& event);
+
+	void push_chunk(boost::uint64_t tag, const data_container& chunk);
+	void push_complete(boost::uint64_t tag, int error_code, const std::string& error_message);
+
+private:
+	int m_fd;
+
+	// set while fd is signaled, saves a syscall per event
+	volatile int m_signaled;
+
+	mpsc_queue_t<completion_event_t> m_events;
+};
+
+} // namespace dealer
+} // namespace cocaine
+
+#endif // _COCAINE_DEALER_COMPLETION_QUEUE_HPP_INCLUDED_
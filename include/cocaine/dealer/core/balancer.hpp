@@ -23,13 +23,16 @@
 
 #include <vector>
 #include <string>
+#include <map>
 
 #include <boost/shared_ptr.hpp>
 #include <boost/ptr_container/ptr_vector.hpp>
 
 #include <zmq.hpp>
 
-#include "cocaine/dealer/core/message_iface.hpp"
+#include "cocaine/dealer/defaults.hpp"
+#include "cocaine/dealer/core/dispatch_message.hpp"
+#include "cocaine/dealer/core/message_cache.hpp"
 #include "cocaine/dealer/core/dealer_object.hpp"
 #include "cocaine/dealer/response_chunk.hpp"
 #include "cocaine/dealer/core/cocaine_endpoint.hpp"
@@ -42,6 +45,8 @@ public:
 	balancer_t(const std::string& identity,
 			   const std::set<cocaine_endpoint_t>& endpoints,
 			   const boost::shared_ptr<context_t>& ctx,
+			   const boost::shared_ptr<message_cache_t>& message_cache,
+			   enum e_balancing_type balancing_type = defaults_t::balancing_type,
 			   bool logging_enabled = true);
 
 	virtual ~balancer_t();
@@ -49,11 +54,18 @@ public:
 	void update_endpoints(const std::set<cocaine_endpoint_t>& endpoints,
 						  std::set<cocaine_endpoint_t>& missing_endpoints);
 
-	bool send(boost::shared_ptr<message_iface>& message, cocaine_endpoint_t& endpoint);
+	bool send(dispatch_message_ptr_t& message, const cocaine_endpoint_t*& endpoint);
 	bool receive(boost::shared_ptr<response_chunk_t>& response);
 
 	bool check_for_responses(int poll_timeout) const;
 
+	// latencies (in seconds) of messages sent to route
+	void register_ack(const std::string& route, double latency);
+	void register_response(const std::string& route, double latency);
+
+	// router socket, to be put into caller's poll set
+	zmq::socket_t& socket();
+
 	static const int socket_timeout = 0;
 
 	#if ZMQ_VERSION_MAJOR < 3
@@ -68,14 +80,46 @@ private:
 	void create_socket();
 	void connect_socket(const std::set<cocaine_endpoint_t>& endpoints);
 
-	cocaine_endpoint_t& get_next_endpoint();
+	// NULL if there's no endpoint to send to
+	const cocaine_endpoint_t* get_next_endpoint();
+	const cocaine_endpoint_t* next_round_robin_endpoint();
+	const cocaine_endpoint_t* next_least_outstanding_endpoint();
+
+	double endpoint_cost(const cocaine_endpoint_t& endpoint);
+	// smooth round robin state of endpoints, keyed by endpoint itself
+	typedef std::map<cocaine_endpoint_t, long long> current_weights_map_t;
+
+	void update_available_endpoints(const current_weights_map_t& carried_weights = current_weights_map_t());
 
 private:
+	// exponentially weighted moving averages of route latencies
+	struct route_stats_t {
+		route_stats_t() :
+			ack_latency(0.0),
+			response_latency(0.0) {}
+
+		double ack_latency;
+		double response_latency;
+	};
+
+	typedef std::map<std::string, route_stats_t> route_stats_map_t;
+
+	static const double latency_ewma_factor;
+	static const double latency_floor;
+
 	boost::shared_ptr<zmq::socket_t>	m_socket;
 	std::set<cocaine_endpoint_t>		m_endpoints;
 	std::vector<cocaine_endpoint_t>		m_endpoints_vec;
+	std::vector<size_t>					m_available_endpoints;
+	std::vector<long long>				m_current_weights;
+	long long							m_total_weight;
 	size_t								m_current_endpoint_index;
 	std::string							m_socket_identity;
+
+	boost::shared_ptr<message_cache_t>	m_message_cache;
+	enum e_balancing_type				m_balancing_type;
+	route_stats_map_t					m_route_stats;
+	unsigned int						m_random_seed;
 };
 
 } // namespace dealer
@@ -37,16 +37,25 @@
 #include "json/json.h"
 
 #include "cocaine/dealer/defaults.hpp"
-#include "cocaine/dealer/core/message_iface.hpp"
+#include "cocaine/dealer/message_path.hpp"
+#include "cocaine/dealer/message_policy.hpp"
+#include "cocaine/dealer/storage/eblob.hpp"
 #include "cocaine/dealer/utils/error.hpp"
 #include "cocaine/dealer/utils/uuid.hpp"
 #include "cocaine/dealer/utils/progress_timer.hpp"
+#include "cocaine/dealer/utils/monotonic_clock.hpp"
+#include "cocaine/dealer/utils/time_value.hpp"
+#include "cocaine/dealer/utils/timer_wheel.hpp"
+#include "cocaine/dealer/utils/intern_table.hpp"
+#include "cocaine/dealer/utils/data_container.hpp"
 
 namespace cocaine {
 namespace dealer {
 
+// concrete message type, dispatch path picks containers at compile time
+// (see dispatch_message.hpp), held through boost::intrusive_ptr
 template<typename DataContainer, typename MetadataContainer>
-class cached_message_t : public message_iface {
+class cached_message_t {
 public:
 	cached_message_t();
 	explicit cached_message_t(const cached_message_t& message);
@@ -56,6 +65,11 @@ public:
 					 const void* data,
 					 size_t data_size);
 
+	// shares data with given container instead of copying it
+	cached_message_t(const message_path_t& path,
+					 const message_policy_t& policy,
+					 const DataContainer& data);
+
 	cached_message_t(void* mdata,
 					 size_t mdata_size);
 
@@ -64,22 +78,34 @@ public:
 	void* data();
 	size_t size() const;
 
+	// shared storage of loaded data
+	const dealer::data_container& buffer() const;
+
 	DataContainer& data_container();
 	MetadataContainer& mdata_container();
 
 	const message_path_t& path() const;
-	const message_policy_t& policy() const;
+	message_policy_t policy() const;
 	wuuid_t& uuid();
 
+	// policy frame as sent to cocaine app, encoded once per message
+	const std::string& packed_server_policy();
+
 	bool is_sent() const;
-	const time_value& sent_timestamp() const;
-	const time_value& enqued_timestamp() const;
+
+	// monotonic, for timeouts and latencies
+	nanoseconds_t sent_at() const;
+	nanoseconds_t enqued_at() const;
+
+	// wall time, derived from monotonic times
+	time_value sent_timestamp() const;
+	time_value enqued_timestamp() const;
 
 	bool ack_received() const;
 	void set_ack_received(bool value);
 
 	const std::string& destination_endpoint() const;
-	void set_destination_endpoint(const std::string& value);
+	void set_destination_endpoint(intern_id_t endpoint_id);
 
 	void mark_as_sent(bool value);
 
@@ -89,9 +115,18 @@ public:
 
 	void reset_ack_timedout();
 
-	message_iface& operator = (const message_iface& rhs);
-	bool operator == (const message_iface& rhs) const;
-	bool operator != (const message_iface& rhs) const;
+	// set by timers of the message owner
+	void mark_as_deadlined();
+	void mark_as_ack_timedout();
+
+	timer_id_t deadline_timer() const;
+	void set_deadline_timer(timer_id_t id);
+	timer_id_t ack_timer() const;
+	void set_ack_timer(timer_id_t id);
+
+	cached_message_t& operator = (const cached_message_t& rhs);
+	bool operator == (const cached_message_t& rhs) const;
+	bool operator != (const cached_message_t& rhs) const;
 
 	bool is_data_loaded();
 	void load_data();
@@ -105,23 +140,42 @@ public:
 
 	void commit_to_eblob(boost::shared_ptr<eblob_t>& blob);
 
+	// messages cross threads, so count is atomic
+	friend void intrusive_ptr_add_ref(cached_message_t* message) {
+		__sync_add_and_fetch(&message->m_refs, 1);
+	}
+
+	friend void intrusive_ptr_release(cached_message_t* message) {
+		if (__sync_sub_and_fetch(&message->m_refs, 1) == 0) {
+			delete message;
+		}
+	}
+
 private:
 	void init();
 	
 private:
 	DataContainer		m_data;
 	MetadataContainer	m_metadata;
+	volatile int		m_refs;
+
+	// kept out of metadata, filled on first send
+	std::string			m_packed_policy;
 };
 
 template<typename DataContainer, typename MetadataContainer>
-cached_message_t<DataContainer, MetadataContainer>::cached_message_t() {
+cached_message_t<DataContainer, MetadataContainer>::cached_message_t() :
+	m_refs(0)
+{
 	init();
 }
 
 template<typename DataContainer, typename MetadataContainer>
-cached_message_t<DataContainer, MetadataContainer>::cached_message_t(const cached_message_t& message) {
-	*this = message;
-}
+cached_message_t<DataContainer, MetadataContainer>::cached_message_t(const cached_message_t& message) :
+	m_data(message.m_data),
+	m_metadata(message.m_metadata),
+	m_refs(0),
+	m_packed_policy(message.m_packed_policy) {}
 
 template<typename DataContainer, typename MetadataContainer> void
 cached_message_t<DataContainer, MetadataContainer>::commit_to_eblob(boost::shared_ptr<eblob_t>& blob) {
@@ -129,7 +183,7 @@ cached_message_t<DataContainer, MetadataContainer>::commit_to_eblob(boost::share
 	msgpack::sbuffer buffer;
 	msgpack::packer<msgpack::sbuffer> pk(&buffer);
 	pk.pack(m_metadata.path());
-	pk.pack(m_metadata.policy);
+	pk.pack(m_metadata.policy());
 	pk.pack(m_metadata.uuid.as_string());
 	pk.pack_raw(m_data.size());
 	pk.pack_raw_body((const char*)m_data.data(), m_data.size());
@@ -142,11 +196,11 @@ template<typename DataContainer, typename MetadataContainer>
 cached_message_t<DataContainer, MetadataContainer>::cached_message_t(const message_path_t& path,
 							   										 const message_policy_t& policy,
 							   										 const void* data,
-							   										 size_t data_size)
+							   										 size_t data_size) :
+	m_refs(0)
 {
 	m_metadata.set_path(path);
-	m_metadata.policy = policy;
-	m_metadata.enqued_timestamp.init_from_current_time();
+	m_metadata.set_policy(policy);
 
 	if (data_size > defaults_t::max_message_size) {
 		throw dealer_error(resource_error, "can't create message, message data too big.");
@@ -157,7 +211,26 @@ cached_message_t<DataContainer, MetadataContainer>::cached_message_t(const messa
 }
 
 template<typename DataContainer, typename MetadataContainer>
-cached_message_t<DataContainer, MetadataContainer>::cached_message_t(void* mdata, size_t mdata_size) {
+cached_message_t<DataContainer, MetadataContainer>::cached_message_t(const message_path_t& path,
+																	 const message_policy_t& policy,
+																	 const DataContainer& data) :
+	m_data(data),
+	m_refs(0)
+{
+	m_metadata.set_path(path);
+	m_metadata.set_policy(policy);
+
+	if (data.size() > defaults_t::max_message_size) {
+		throw dealer_error(resource_error, "can't create message, message data too big.");
+	}
+
+	init();
+}
+
+template<typename DataContainer, typename MetadataContainer>
+cached_message_t<DataContainer, MetadataContainer>::cached_message_t(void* mdata, size_t mdata_size) :
+	m_refs(0)
+{
 	m_metadata.load_data(m_metadata, mdata_size);
 }
 
@@ -168,7 +241,7 @@ cached_message_t<DataContainer, MetadataContainer>::~cached_message_t() {
 template<typename DataContainer, typename MetadataContainer> void
 cached_message_t<DataContainer, MetadataContainer>::init() {
 	m_metadata.uuid.generate();
-	m_metadata.enqued_timestamp.init_from_current_time();
+	m_metadata.enqued_at = monotonic_clock_t::now();
 }
 
 template<typename DataContainer, typename MetadataContainer> int
@@ -178,16 +251,21 @@ cached_message_t<DataContainer, MetadataContainer>::retries_count() const {
 
 template<typename DataContainer, typename MetadataContainer> void
 cached_message_t<DataContainer, MetadataContainer>::increment_retries_count() {
-	++m_metadata.retries_count;
+	// saturates, unlimited retries would wrap otherwise
+	if (m_metadata.retries_count < 0xffff) {
+		++m_metadata.retries_count;
+	}
 }
 
 template<typename DataContainer, typename MetadataContainer> bool
 cached_message_t<DataContainer, MetadataContainer>::can_retry() const {
-	if (m_metadata.policy.max_retries < 0) {
+	int max_retries = m_metadata.policy().max_retries;
+
+	if (max_retries < 0) {
 		return true;
 	}
 
-	return (m_metadata.retries_count < m_metadata.policy.max_retries ? true : false);
+	return (m_metadata.retries_count < max_retries ? true : false);
 }
 
 template<typename DataContainer, typename MetadataContainer> bool
@@ -215,6 +293,11 @@ cached_message_t<DataContainer, MetadataContainer>::size() const {
 	return m_data.size();
 }
 
+template<typename DataContainer, typename MetadataContainer> const data_container&
+cached_message_t<DataContainer, MetadataContainer>::buffer() const {
+	return m_data.buffer();
+}
+
 template<typename DataContainer, typename MetadataContainer> DataContainer&
 cached_message_t<DataContainer, MetadataContainer>::data_container() {
 	return m_data;
@@ -225,47 +308,24 @@ cached_message_t<DataContainer, MetadataContainer>::mdata_container() {
 	return m_metadata;
 }
 
-template<typename DataContainer, typename MetadataContainer> message_iface&
-cached_message_t<DataContainer, MetadataContainer>::operator = (const message_iface& rhs) {
-	if (this == &rhs) {
-		return *this;
-	}
-
-	try {
-		const cached_message_t<DataContainer, MetadataContainer>& dc = dynamic_cast<const cached_message_t<DataContainer, MetadataContainer>& >(rhs);
-
-		m_data = dc.m_data;
-		m_metadata = dc.m_metadata;
-	}
-	catch (const std::exception& ex) {
-		std::string error_msg = ex.what();
-		error_msg = "error in cached_message_t<DataContainer, MetadataContainer>::operator = (), details: " + error_msg;
-		throw internal_error(error_msg);
+template<typename DataContainer, typename MetadataContainer> cached_message_t<DataContainer, MetadataContainer>&
+cached_message_t<DataContainer, MetadataContainer>::operator = (const cached_message_t& rhs) {
+	if (this != &rhs) {
+		m_data = rhs.m_data;
+		m_metadata = rhs.m_metadata;
+		m_packed_policy = rhs.m_packed_policy;
 	}
 
 	return *this;
 }
 
 template<typename DataContainer, typename MetadataContainer> bool
-cached_message_t<DataContainer, MetadataContainer>::operator == (const message_iface& rhs) const {
-
-	bool comparison_result = false;
-
-	try {
-		const cached_message_t<DataContainer, MetadataContainer>& dc = dynamic_cast<const cached_message_t<DataContainer, MetadataContainer>&>(rhs);
-		comparison_result = (m_metadata.uuid == dc.m_metadata.uuid);
-	}
-	catch (const std::exception& ex) {
-		std::string error_msg = ex.what();
-		error_msg = "error in cached_message_t<DataContainer, MetadataContainer>::operator = (), details: " + error_msg;
-		throw internal_error(error_msg);
-	}
-
-	return comparison_result;
+cached_message_t<DataContainer, MetadataContainer>::operator == (const cached_message_t& rhs) const {
+	return (m_metadata.uuid == rhs.m_metadata.uuid);
 }
 
 template<typename DataContainer, typename MetadataContainer> bool
-cached_message_t<DataContainer, MetadataContainer>::operator != (const message_iface& rhs) const {
+cached_message_t<DataContainer, MetadataContainer>::operator != (const cached_message_t& rhs) const {
 	return !(*this == rhs);
 }
 
@@ -274,39 +334,75 @@ cached_message_t<DataContainer, MetadataContainer>::uuid() {
 	return m_metadata.uuid;
 }
 
+template<typename DataContainer, typename MetadataContainer> const std::string&
+cached_message_t<DataContainer, MetadataContainer>::packed_server_policy() {
+	if (!m_packed_policy.empty()) {
+		return m_packed_policy;
+	}
+
+	policy_t server_policy = m_metadata.policy().server_policy();
+
+	if (server_policy.deadline > 0.0) {
+		// awful semantics! convert deadline [timeout value] to actual [deadline time]
+		time_value server_deadline = m_metadata.enqued_timestamp();
+		server_deadline += server_policy.deadline;
+		server_policy.deadline = server_deadline.as_double();
+	}
+
+	msgpack::sbuffer sbuf;
+	msgpack::pack(sbuf, server_policy);
+	m_packed_policy.assign(sbuf.data(), sbuf.size());
+
+	return m_packed_policy;
+}
+
 template<typename DataContainer, typename MetadataContainer> bool
 cached_message_t<DataContainer, MetadataContainer>::is_sent() const {
-	return m_metadata.is_sent;
+	return m_metadata.flag(MetadataContainer::RMF_SENT);
+}
+
+template<typename DataContainer, typename MetadataContainer> nanoseconds_t
+cached_message_t<DataContainer, MetadataContainer>::sent_at() const {
+	return m_metadata.sent_at;
 }
 
-template<typename DataContainer, typename MetadataContainer> const time_value&
+template<typename DataContainer, typename MetadataContainer> nanoseconds_t
+cached_message_t<DataContainer, MetadataContainer>::enqued_at() const {
+	return m_metadata.enqued_at;
+}
+
+template<typename DataContainer, typename MetadataContainer> time_value
 cached_message_t<DataContainer, MetadataContainer>::sent_timestamp() const {
-	return m_metadata.sent_timestamp;
+	if (!m_metadata.flag(MetadataContainer::RMF_SENT)) {
+		return time_value();
+	}
+
+	return monotonic_clock_t::to_wall_time(m_metadata.sent_at);
 }
 
-template<typename DataContainer, typename MetadataContainer> const time_value&
+template<typename DataContainer, typename MetadataContainer> time_value
 cached_message_t<DataContainer, MetadataContainer>::enqued_timestamp() const {
-	return m_metadata.enqued_timestamp;
+	return m_metadata.enqued_timestamp();
 }
 
 template<typename DataContainer, typename MetadataContainer> bool
 cached_message_t<DataContainer, MetadataContainer>::ack_received() const {
-	return m_metadata.ack_received;
+	return m_metadata.flag(MetadataContainer::RMF_ACK_RECEIVED);
 }
 
 template<typename DataContainer, typename MetadataContainer> void
 cached_message_t<DataContainer, MetadataContainer>::set_ack_received(bool value) {
-	m_metadata.ack_received = value;
+	m_metadata.set_flag(MetadataContainer::RMF_ACK_RECEIVED, value);
 }
 
 template<typename DataContainer, typename MetadataContainer> const std::string&
 cached_message_t<DataContainer, MetadataContainer>::destination_endpoint() const {
-	return m_metadata.destination_endpoint;
+	return m_metadata.destination_endpoint();
 }
 
 template<typename DataContainer, typename MetadataContainer> void
-cached_message_t<DataContainer, MetadataContainer>::set_destination_endpoint(const std::string& value) {
-	m_metadata.destination_endpoint = value;	
+cached_message_t<DataContainer, MetadataContainer>::set_destination_endpoint(intern_id_t endpoint_id) {
+	m_metadata.endpoint_id = endpoint_id;
 }
 
 template<typename DataContainer, typename MetadataContainer> const message_path_t&
@@ -314,65 +410,86 @@ cached_message_t<DataContainer, MetadataContainer>::path() const {
 	return m_metadata.path();
 }
 
-template<typename DataContainer, typename MetadataContainer> const message_policy_t&
+template<typename DataContainer, typename MetadataContainer> message_policy_t
 cached_message_t<DataContainer, MetadataContainer>::policy() const {
-	return m_metadata.policy;
+	return m_metadata.policy();
 }
 
 template<typename DataContainer, typename MetadataContainer> void
 cached_message_t<DataContainer, MetadataContainer>::mark_as_sent(bool value) {
-	if (value) {
-		m_metadata.is_sent = true;
-		m_metadata.sent_timestamp.init_from_current_time();
-	}
-	else {
-		m_metadata.is_sent = false;
-		m_metadata.sent_timestamp.reset();
-	}
+	m_metadata.set_flag(MetadataContainer::RMF_SENT, value);
+	m_metadata.sent_at = (value ? monotonic_clock_t::loop_now() : 0);
 }
 
 template<typename DataContainer, typename MetadataContainer> bool
 cached_message_t<DataContainer, MetadataContainer>::is_ack_timedout() {
-	return m_metadata.ack_timed_out;
+	return m_metadata.flag(MetadataContainer::RMF_ACK_TIMED_OUT);
 }
 
 template<typename DataContainer, typename MetadataContainer> bool
 cached_message_t<DataContainer, MetadataContainer>::is_deadlined() {
-	return m_metadata.deadlined;
+	return m_metadata.flag(MetadataContainer::RMF_DEADLINED);
 }
 
 template<typename DataContainer, typename MetadataContainer> void
 cached_message_t<DataContainer, MetadataContainer>::reset_ack_timedout() {
-	m_metadata.ack_timed_out = false;
+	m_metadata.set_flag(MetadataContainer::RMF_ACK_TIMED_OUT, false);
+}
+
+template<typename DataContainer, typename MetadataContainer> void
+cached_message_t<DataContainer, MetadataContainer>::mark_as_deadlined() {
+	m_metadata.set_flag(MetadataContainer::RMF_DEADLINED, true);
+}
+
+template<typename DataContainer, typename MetadataContainer> void
+cached_message_t<DataContainer, MetadataContainer>::mark_as_ack_timedout() {
+	m_metadata.set_flag(MetadataContainer::RMF_ACK_TIMED_OUT, true);
+}
+
+template<typename DataContainer, typename MetadataContainer> timer_id_t
+cached_message_t<DataContainer, MetadataContainer>::deadline_timer() const {
+	return m_metadata.deadline_timer;
+}
+
+template<typename DataContainer, typename MetadataContainer> void
+cached_message_t<DataContainer, MetadataContainer>::set_deadline_timer(timer_id_t id) {
+	m_metadata.deadline_timer = id;
+}
+
+template<typename DataContainer, typename MetadataContainer> timer_id_t
+cached_message_t<DataContainer, MetadataContainer>::ack_timer() const {
+	return m_metadata.ack_timer;
+}
+
+template<typename DataContainer, typename MetadataContainer> void
+cached_message_t<DataContainer, MetadataContainer>::set_ack_timer(timer_id_t id) {
+	m_metadata.ack_timer = id;
 }
 
 template<typename DataContainer, typename MetadataContainer> bool
 cached_message_t<DataContainer, MetadataContainer>::is_expired() {
-	time_value curr_time = time_value::get_current_time();
+	nanoseconds_t curr_time = monotonic_clock_t::loop_now();
+	message_policy_t policy = m_metadata.policy();
 
 	// process policy deadlie
-	if (m_metadata.policy.deadline > 0.0f) {
-		time_value elapsed_from_enqued = curr_time.distance(m_metadata.enqued_timestamp);
-		double elapsed = elapsed_from_enqued.as_double();
-		double deadline = m_metadata.policy.deadline;
+	if (policy.deadline > 0.0f) {
+		nanoseconds_t deadline = monotonic_clock_t::from_seconds(policy.deadline);
 
-		if (elapsed > deadline) {
-			m_metadata.deadlined = true;
+		if (curr_time > m_metadata.enqued_at + deadline) {
+			mark_as_deadlined();
 		}
 	}
 
 	// check policy ack_timeout
-	if (m_metadata.is_sent && !ack_received()) {
-		time_value elapsed_from_sent = curr_time.distance(m_metadata.sent_timestamp);
-		double elapsed = elapsed_from_sent.as_double();
-		double ack_timeout = m_metadata.policy.ack_timeout;
+	if (is_sent() && !ack_received()) {
+		nanoseconds_t ack_timeout = monotonic_clock_t::from_seconds(policy.ack_timeout);
 
-		if (elapsed > ack_timeout) {
-			m_metadata.ack_timed_out = true;
+		if (curr_time > m_metadata.sent_at + ack_timeout) {
+			mark_as_ack_timedout();
 		}
 	}
 
-	return (m_metadata.ack_timed_out || m_metadata.deadlined);
+	return (is_ack_timedout() || is_deadlined());
 }
 
 template<typename DataContainer, typename MetadataContainer> void
@@ -0,0 +1,70 @@
+/*
+    Copyright (c) 2011-2012 Rim Zaidullin <creator@bash.org.ru>
+    Copyright (c) 2011-2012 Other contributors as noted in the AUTHORS file.
+
+    This file is part of Cocaine.
+
+    Cocaine is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Cocaine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>. 
+*/
+
+#ifndef _COCAINE_DEALER_CALLBACK_EXECUTOR_HPP_INCLUDED_
+#define _COCAINE_DEALER_CALLBACK_EXECUTOR_HPP_INCLUDED_
+
+#include <deque>
+#include <vector>
+
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/utility.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+namespace cocaine {
+namespace dealer {
+
+// pool of threads running user callbacks off dispatching threads,
+// tasks posted with the same key run on the same thread in post order
+class callback_executor_t : private boost::noncopyable {
+public:
+	typedef boost::function<void()> task_t;
+
+public:
+	explicit callback_executor_t(unsigned int threads_count);
+	virtual ~callback_executor_t();
+
+	void post(size_t key, const task_t& task);
+
+private:
+	struct worker_t {
+		worker_t() :
+			is_running(true) {}
+
+		std::deque<task_t>			tasks;
+		bool						is_running;
+		boost::mutex				mutex;
+		boost::condition_variable	cond_var;
+		boost::thread				thread;
+	};
+
+	static void run(worker_t* worker);
+
+private:
+	std::vector<boost::shared_ptr<worker_t> > m_workers;
+};
+
+} // namespace dealer
+} // namespace cocaine
+
+#endif // _COCAINE_DEALER_CALLBACK_EXECUTOR_HPP_INCLUDED_
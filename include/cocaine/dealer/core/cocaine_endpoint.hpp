@@ -25,7 +25,10 @@
 
 #include <boost/lexical_cast.hpp>
 
+#include <msgpack.hpp>
+
 #include "cocaine/dealer/utils/progress_timer.hpp"
+#include "cocaine/dealer/utils/intern_table.hpp"
 
 namespace cocaine {
 namespace dealer {
@@ -33,26 +36,39 @@ namespace dealer {
  // predeclaration
 struct cocaine_endpoint_t {
 public:
-	cocaine_endpoint_t() {}
+	cocaine_endpoint_t() :
+		weight(0),
+		endpoint_id(0) {}
 
 	cocaine_endpoint_t(const std::string& endpoint_, const std::string& route_, int weight_ = 0) :
 		endpoint(endpoint_),
 		route(route_),
-		weight(weight_) {}
+		weight(weight_),
+		endpoint_id(intern_table_t<std::string>::intern(endpoint_))
+	{
+		// route frame is the same for every message sent to endpoint
+		msgpack::sbuffer sbuf;
+		msgpack::pack(sbuf, route);
+		packed_route.assign(sbuf.data(), sbuf.size());
+	}
 
 	~cocaine_endpoint_t() {}
 
 	cocaine_endpoint_t(const cocaine_endpoint_t& rhs) :
 		endpoint(rhs.endpoint),
 		route(rhs.route),
+		packed_route(rhs.packed_route),
 		weight(rhs.weight),
+		endpoint_id(rhs.endpoint_id),
 		announce_timer(rhs.announce_timer) {}
 
 	cocaine_endpoint_t& operator = (const cocaine_endpoint_t& rhs) {
 		if (this != &rhs) {
 			endpoint = rhs.endpoint;
 			route = rhs.route;
+			packed_route = rhs.packed_route;
 			weight = rhs.weight;
+			endpoint_id = rhs.endpoint_id;
 			announce_timer = rhs.announce_timer;
 		}
 
@@ -84,7 +100,12 @@ public:
 
 	std::string		endpoint;
 	std::string		route;
+	std::string		packed_route;
 	int				weight;
+
+	// messages keep this id instead of endpoint string
+	intern_id_t		endpoint_id;
+
 	progress_timer	announce_timer;
 };
 
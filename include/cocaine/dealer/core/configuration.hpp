@@ -58,6 +58,9 @@ public:
 	unsigned int config_version() const;
 	enum e_message_cache_type message_cache_type() const;
 	float endpoint_timeout() const;
+	unsigned int reactor_threads() const;
+	unsigned int callback_threads() const;
+	enum e_message_id_type message_id_type() const;
 
 	enum e_logger_type logger_type() const;
 	unsigned int logger_flags() const;
@@ -122,6 +125,12 @@ private:
 
 	// endpoint announce timeout
 	float m_endpoint_timeout;
+
+	// handles dispatch threads
+	unsigned int m_reactor_threads;
+	unsigned int m_callback_threads;
+
+	enum e_message_id_type m_message_id_type;
 };
 
 } // namespace dealer
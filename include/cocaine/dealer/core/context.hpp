@@ -24,6 +24,7 @@
 #include <string>
 #include <map>
 #include <memory>
+#include <vector>
 
 #include <zmq.hpp>
 
@@ -39,6 +40,8 @@ namespace cocaine {
 namespace dealer {
 
 class eblob_storage_t;
+class reactor_t;
+class callback_executor_t;
 
 class context_t : private boost::noncopyable, public boost::enable_shared_from_this<context_t> {
 public:
@@ -53,6 +56,12 @@ public:
 	boost::shared_ptr<configuration_t> config();
 	boost::shared_ptr<zmq::context_t> zmq_context();
 	boost::shared_ptr<eblob_storage_t> storage();
+
+	// reactor thread that serves handle with given description
+	boost::shared_ptr<reactor_t> reactor_for(const std::string& handle_description);
+
+	// empty if callbacks are invoked on reactor threads
+	boost::shared_ptr<callback_executor_t> callback_executor();
     //boost::shared_ptr<statistics_collector> stats();
 
 private:
@@ -60,6 +69,8 @@ private:
 	boost::shared_ptr<base_logger_t> m_logger;
 	boost::shared_ptr<configuration_t> m_config;
 	boost::shared_ptr<eblob_storage_t> m_storage;
+	std::vector<boost::shared_ptr<reactor_t> > m_reactors;
+	boost::shared_ptr<callback_executor_t> m_callback_executor;
     //boost::shared_ptr<statistics_collector> m_stats;
 };
 
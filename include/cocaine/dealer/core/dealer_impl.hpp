@@ -35,6 +35,7 @@
 
 #include "cocaine/dealer/forwards.hpp"
 #include "cocaine/dealer/message.hpp"
+#include "cocaine/dealer/completion_queue.hpp"
 #include "cocaine/dealer/core/context.hpp"
 #include "cocaine/dealer/core/service.hpp"
 #include "cocaine/dealer/core/dealer_object.hpp"
@@ -75,7 +76,22 @@ public:
 				 size_t size,
 				 const message_path_t& path);
 
-	
+	void
+	send_message(const void* data,
+				 size_t size,
+				 const message_path_t& path,
+				 const message_policy_t& policy,
+				 const response_chunk_callback_t& on_chunk,
+				 const response_complete_callback_t& on_complete);
+
+	void
+	send_message(const void* data,
+				 size_t size,
+				 const message_path_t& path,
+				 const message_policy_t& policy,
+				 const boost::shared_ptr<completion_queue_t>& queue,
+				 boost::uint64_t tag);
+
 	responses_list_t
 	send_messages(const void* data,
 				  size_t size,
@@ -87,12 +103,30 @@ public:
 				  size_t size,
 				  const message_path_t& path);
 
-	boost::shared_ptr<message_iface>
+	// message shares data with container
+	response_ptr_t
+	send_message(const data_container& data,
+				 const message_path_t& path,
+				 const message_policy_t& policy);
+
+	response_ptr_t
+	send_message(const data_container& data,
+				 const message_path_t& path);
+
+	responses_list_t
+	send_messages_batch(const std::vector<message_t>& messages);
+
+	dispatch_message_ptr_t
 	create_message(const void* data,
 				   size_t size,
 				   const message_path_t& path,
 				   const message_policy_t& policy);
 
+	dispatch_message_ptr_t
+	create_message(const data_container& data,
+				   const message_path_t& path,
+				   const message_policy_t& policy);
+
 	message_policy_t policy_for_service(const std::string& service_alias);
 
 	size_t stored_messages_count(const std::string& service_alias);
@@ -122,13 +156,13 @@ private:
 
 	size_t m_messages_cache_size;
 
-	// dealer service name mapped to service
+	// dealer service name mapped to service, not modified
+	// between construction and disconnect(), read without locks
 	services_map_t m_services;
 
 	std::auto_ptr<overseer_t> m_overseer;
 
 	// synchronization
-	boost::mutex m_mutex;
 	boost::mutex m_regex_mutex;
 
 	// alive state
@@ -0,0 +1,42 @@
+/*
+    Copyright (c) 2011-2012 Rim Zaidullin <creator@bash.org.ru>
+    Copyright (c) 2011-2012 Other contributors as noted in the AUTHORS file.
+
+    This file is part of Cocaine.
+
+    Cocaine is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Cocaine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>. 
+*/
+
+#ifndef _COCAINE_DEALER_DISPATCH_MESSAGE_HPP_INCLUDED_
+#define _COCAINE_DEALER_DISPATCH_MESSAGE_HPP_INCLUDED_
+
+#include <boost/intrusive_ptr.hpp>
+
+#include "cocaine/dealer/utils/data_container.hpp"
+#include "cocaine/dealer/core/cached_message.hpp"
+#include "cocaine/dealer/core/request_metadata.hpp"
+
+namespace cocaine {
+namespace dealer {
+
+// message type of in-memory dispatch path, queues, indexes and timers
+// hold it directly so calls on queued messages are not virtual and
+// refcount lives in the message itself
+typedef cached_message_t<data_container, request_metadata_t> dispatch_message_t;
+typedef boost::intrusive_ptr<dispatch_message_t> dispatch_message_ptr_t;
+
+} // namespace dealer
+} // namespace cocaine
+
+#endif // _COCAINE_DEALER_DISPATCH_MESSAGE_HPP_INCLUDED_
@@ -39,8 +39,9 @@
 #include "json/json.h"
 
 #include "cocaine/dealer/core/balancer.hpp"
+#include "cocaine/dealer/core/reactor.hpp"
 #include "cocaine/dealer/core/handle_info.hpp"
-#include "cocaine/dealer/core/message_iface.hpp"
+#include "cocaine/dealer/core/dispatch_message.hpp"
 #include "cocaine/dealer/core/message_cache.hpp"
 #include "cocaine/dealer/core/dealer_object.hpp"
 #include "cocaine/dealer/response_chunk.hpp"
@@ -80,9 +81,10 @@ public:
 	void set_responce_callback(responce_callback_t callback);
 
 	// message processing
-	void enqueue_message(const boost::shared_ptr<message_iface>& message);
+	// false if handle was already killed
+	bool enqueue_message(const dispatch_message_ptr_t& message);
 	void make_all_messages_new();
-	void assign_message_queue(const message_cache_t::message_queue_ptr_t& message_queue);
+	bool assign_message_queue(const message_cache_t::message_queue_ptr_t& message_queue);
 
 	// info retrieval
 	const handle_info_t& info() const;
@@ -91,8 +93,24 @@ public:
 	boost::shared_ptr<message_cache_t> messages_cache() const;
 	void kill();
 
+	// messages and responses processed per reactor iteration
+	static const int dispatch_batch_size = 100;
+
+	// control socket, balancer socket and message cache wakeup fd
+	static const size_t poll_items_count = 3;
+
 private:
-	void dispatch_messages();
+	friend class reactor_t;
+
+	// called from reactor thread only
+	void start_dispatch();
+	void stop_dispatch();
+	void fill_poll_items(zmq_pollitem_t* poll_items);
+	long poll_timeout();
+	void process_poll_items(const zmq_pollitem_t* poll_items);
+
+	// dispatch failed with an exception, reactor drops the handle after it
+	void abort_dispatch(const std::string& error);
 
 	// working with control messages
 	void dispatch_control_messages(int type, balancer_t& balancer);
@@ -103,17 +121,17 @@ private:
 	// working with messages
 	bool dispatch_next_available_message(balancer_t& balancer);
 	void dispatch_next_available_response(balancer_t& balancer);
+	double message_latency(const dispatch_message_ptr_t& message);
 	void process_deadlined_messages();
 
 	// working with responces
 	void enqueue_response(boost::shared_ptr<response_chunk_t>& response);
 	void remove_from_persistent_storage(const boost::shared_ptr<response_chunk_t>& response);
-	void remove_from_persistent_storage(wuuid_t& uuid,
+	void remove_from_persistent_storage(const wuuid_t& uuid,
 										const message_policy_t& policy,
 										const std::string& alias);
 private:
 	handle_info_t		m_info;
-	boost::thread		m_thread;
 	boost::mutex		m_mutex;
 	volatile bool		m_is_running;
 	volatile bool		m_is_connected;
@@ -124,11 +142,13 @@ private:
 	std::auto_ptr<zmq::socket_t> m_zmq_control_socket;
 	bool m_receiving_control_socket_ok;
 
-	responce_callback_t m_response_callback;
+	// dispatch state, owned by reactor thread
+	boost::shared_ptr<reactor_t>	m_reactor;
+	std::auto_ptr<balancer_t>		m_balancer;
+	socket_ptr_t					m_control_socket;
+	bool							m_has_pending_work;
 
-	progress_timer m_last_response_timer;
-	progress_timer m_deadlined_messages_timer;
-	progress_timer m_control_messages_timer;
+	responce_callback_t m_response_callback;
 };
 
 } // namespace dealer
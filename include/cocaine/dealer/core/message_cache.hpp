@@ -34,69 +34,121 @@
 #include "cocaine/dealer/defaults.hpp"
 #include "cocaine/dealer/core/context.hpp"
 #include "cocaine/dealer/core/dealer_object.hpp"
-#include "cocaine/dealer/core/message_iface.hpp"
+#include "cocaine/dealer/core/dispatch_message.hpp"
+#include "cocaine/dealer/core/sent_messages_index.hpp"
 #include "cocaine/dealer/utils/uuid.hpp"
+#include "cocaine/dealer/utils/wakeup_fd.hpp"
+#include "cocaine/dealer/utils/timer_wheel.hpp"
+#include "cocaine/dealer/utils/mpsc_queue.hpp"
 
 namespace cocaine {
 namespace dealer {
 
+// enqueue methods may be called from any thread, the rest of the cache
+// belongs to the dispatching (reactor) thread of the handle, or to the
+// service once the handle was detached from reactor
 class message_cache_t : private boost::noncopyable, public dealer_object_t {
 public:
-	typedef boost::shared_ptr<message_iface> cached_message_ptr_t;
+	typedef dispatch_message_ptr_t cached_message_ptr_t;
 	typedef std::deque<cached_message_ptr_t> message_queue_t;
 	typedef boost::shared_ptr<message_queue_t> message_queue_ptr_t;
 	typedef std::pair<std::string, message_path_t> message_data_t;
 	typedef std::vector<message_data_t> expired_messages_data_t;
 
-	// <uuid, sent message>
-	typedef std::map<std::string, cached_message_ptr_t> sent_messages_map_t; 
-
-	// <route, sent messages map>
-	typedef std::map<std::string, sent_messages_map_t> route_sent_messages_map_t;
-
 public:
 	message_cache_t(const boost::shared_ptr<context_t>& ctx,
 					bool logging_enabled = true);
 
 	virtual ~message_cache_t();
 
-	void enqueue(const boost::shared_ptr<message_iface>& message);
-	void append_message_queue(message_queue_ptr_t queue);
+	// false once intake was closed
+	bool enqueue(const dispatch_message_ptr_t& message);
+	bool append_message_queue(message_queue_ptr_t queue);
+
+	// reject further enqueues and wait for ones in progress
+	void close_intake();
 
 	size_t new_messages_count();
 	size_t sent_messages_count();
+	size_t sent_messages_count(const std::string& route);
 
-	void enqueue_with_priority(const boost::shared_ptr<message_iface>& message);
+	void enqueue_with_priority(const dispatch_message_ptr_t& message);
 	cached_message_ptr_t get_new_message();
 	
 	bool get_sent_message(const std::string& route,
-						  wuuid_t& uuid,
-						  boost::shared_ptr<message_iface>& message);
+						  const wuuid_t& uuid,
+						  dispatch_message_ptr_t& message);
 
 	message_queue_ptr_t new_messages();
 	void move_new_message_to_sent(const std::string& route);
-	void move_sent_message_to_new(const std::string& route, wuuid_t& uuid);
-	void move_sent_message_to_new_front(const std::string& route, wuuid_t& uuid);
-	void remove_message_from_cache(const std::string& route, wuuid_t& uuid);
+	void move_sent_message_to_new(const std::string& route, const wuuid_t& uuid);
+	void move_sent_message_to_new_front(const std::string& route, const wuuid_t& uuid);
+	void remove_message_from_cache(const std::string& route, const wuuid_t& uuid);
 	void make_all_messages_new();
 	void get_expired_messages(message_queue_t& expired_messages);
+	void mark_ack_received(const cached_message_ptr_t& message);
+
+	// millisecs until next message timer is due, -1 if none armed
+	long timers_timeout();
 	void make_all_messages_new_for_route(const std::string& route);
 
-	bool reshedule_message(const std::string& route, wuuid_t& uuid);
+	bool reshedule_message(const std::string& route, const wuuid_t& uuid);
 
 	void lock();
 
+	// readable whenever messages were added to the new queue
+	int wakeup_fd() const;
+	void drain_wakeup();
+
 	void log_stats();
 
 private:
-	static bool is_message_expired(cached_message_ptr_t msg);
+	enum e_message_timer_type {
+		MTT_DEADLINE = 1,
+		MTT_ACK
+	};
+
+	typedef std::pair<cached_message_ptr_t, e_message_timer_type> message_timer_t;
+
+	// <message, enqueue with priority>
+	typedef std::pair<cached_message_ptr_t, bool> intake_entry_t;
+
+	// move messages enqueued by other threads to new messages queue
+	void drain_intake();
+
+	bool enter_intake();
+	void leave_intake();
+
+	void arm_deadline_timer(const cached_message_ptr_t& message);
+	void arm_ack_timer(const cached_message_ptr_t& message);
+	void cancel_ack_timer(const cached_message_ptr_t& message);
+	void cancel_timers(const cached_message_ptr_t& message);
+
+	bool remove_expired_message(const cached_message_ptr_t& message);
+
+	// drop deadlined messages left in new queue by remove_expired_message()
+	void skip_expired_new_messages();
+	void compact_new_messages();
 
 private:
 	enum e_message_cache_type	m_type;
-	route_sent_messages_map_t	m_sent_messages;
+	sent_messages_index_t		m_sent_messages;
 	message_queue_ptr_t			m_new_messages;
+
+	// deadlined messages still sitting in m_new_messages
+	size_t						m_expired_new_messages;
 	bool m_locked;
-	boost::mutex m_mutex;
+	wakeup_fd_t m_wakeup;
+
+	mpsc_queue_t<intake_entry_t>	m_intake;
+	std::vector<intake_entry_t>		m_intake_batch;
+
+	// enqueues in progress and closed flag
+	volatile int m_intake_producers;
+	volatile int m_intake_closed;
+
+	// deadline and ack timeout timers
+	timer_wheel_t<message_timer_t> m_timers;
 };
 
 } // namespace dealer
@@ -57,6 +57,9 @@ public:
 	size_t size() const;
 	bool empty() const;
 
+	// refcounted storage of loaded data, stays valid after unload_data()
+	const data_container& buffer() const;
+
 	bool is_data_loaded();
 	void load_data();
 	void unload_data();
@@ -65,16 +68,13 @@ public:
 
 	static const size_t EBLOB_COLUMN = 1;
 
-protected:
-	void allocate_memory();
-
 protected:
 	// persistant storage
 	boost::shared_ptr<eblob_t> blob_;
 	bool data_in_memory_;
 
 	// data
-	unsigned char* data_;
+	data_container buffer_;
 	size_t size_;
 
 	// key to store data in eblob_t
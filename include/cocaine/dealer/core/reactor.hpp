@@ -0,0 +1,83 @@
+/*
+    Copyright (c) 2011-2012 Rim Zaidullin <creator@bash.org.ru>
+    Copyright (c) 2011-2012 Other contributors as noted in the AUTHORS file.
+
+    This file is part of Cocaine.
+
+    Cocaine is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Cocaine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>. 
+*/
+
+#ifndef _COCAINE_DEALER_REACTOR_HPP_INCLUDED_
+#define _COCAINE_DEALER_REACTOR_HPP_INCLUDED_
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <zmq.hpp>
+
+#include <boost/utility.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+#include "cocaine/dealer/utils/wakeup_fd.hpp"
+
+namespace cocaine {
+namespace dealer {
+
+class handle_t;
+
+// single thread multiplexing sockets, queues and timers of many handles,
+// all handle's dispatch code runs on the reactor it was attached to
+class reactor_t : private boost::noncopyable {
+public:
+	reactor_t();
+	virtual ~reactor_t();
+
+	// both block until reactor thread started or stopped handle dispatch,
+	// attach throws internal_error if dispatch could not be started
+	void attach(handle_t* handle);
+	void detach(handle_t* handle);
+
+private:
+	typedef std::vector<handle_t*> handles_list_t;
+	typedef std::map<handle_t*, std::string> failed_attaches_t;
+
+	void run();
+	void process_requests();
+
+private:
+	// accessed from reactor thread only
+	handles_list_t				m_handles;
+	std::vector<zmq_pollitem_t>	m_poll_items;
+
+	// pending requests from other threads
+	handles_list_t m_attach_requests;
+	handles_list_t m_detach_requests;
+
+	// <handle, error> for attach requests whose start_dispatch() threw
+	failed_attaches_t m_failed_attaches;
+
+	boost::mutex				m_mutex;
+	boost::condition_variable	m_cond_var;
+	wakeup_fd_t					m_wakeup;
+	volatile bool				m_is_running;
+	boost::thread				m_thread;
+};
+
+} // namespace dealer
+} // namespace cocaine
+
+#endif // _COCAINE_DEALER_REACTOR_HPP_INCLUDED_
@@ -21,83 +21,154 @@
 #ifndef _COCAINE_DEALER_REQUEST_METADATA_HPP_INCLUDED_
 #define _COCAINE_DEALER_REQUEST_METADATA_HPP_INCLUDED_
 
+#include <cstddef>
 #include <string>
 #include <sstream>
 
+#include <boost/cstdint.hpp>
 #include <boost/lexical_cast.hpp>
 #include <boost/shared_ptr.hpp>
+#include <boost/static_assert.hpp>
 
 #include "cocaine/dealer/message_path.hpp"
+#include "cocaine/dealer/message_policy.hpp"
 #include "cocaine/dealer/utils/time_value.hpp"
+#include "cocaine/dealer/utils/monotonic_clock.hpp"
 #include "cocaine/dealer/utils/uuid.hpp"
+#include "cocaine/dealer/utils/timer_wheel.hpp"
+#include "cocaine/dealer/utils/intern_table.hpp"
 #include "cocaine/dealer/storage/eblob.hpp"
 #include "cocaine/dealer/core/cocaine_endpoint.hpp"
 
-#include <boost/flyweight.hpp>
-
 #include <msgpack.hpp>
 
 namespace cocaine {
 namespace dealer {
 
+// packed message metadata: path and endpoint are ids into process-wide
+// intern tables (both come from a bounded set), policy is kept inline,
+// times are monotonic nanoseconds, state is kept in bit flags; everything
+// read by dispatch and expiry fits the first cache line, timer ids used
+// only on arm and cancel follow it
 struct request_metadata_t {
-		request_metadata_t() :
-		data_size(0),
-		ack_received(false),
-		ack_timed_out(false),
-		deadlined(false),
-		is_sent(false),
-		retries_count(0) {}
-
-	virtual ~request_metadata_t() {}
+	enum {
+		RMF_ACK_RECEIVED	= 1 << 0,
+		RMF_ACK_TIMED_OUT	= 1 << 1,
+		RMF_DEADLINED		= 1 << 2,
+		RMF_SENT			= 1 << 3,
+		RMF_URGENT			= 1 << 4,
+		RMF_PERSISTENT		= 1 << 5
+	};
+
+	request_metadata_t() :
+		path_id(0),
+		endpoint_id(0),
+		policy_timeout(0.0f),
+		policy_ack_timeout(0.0f),
+		policy_deadline(0.0f),
+		policy_max_retries(0),
+		retries_count(0),
+		flags(0),
+		enqued_at(0),
+		sent_at(0),
+		deadline_timer(invalid_timer_id),
+		ack_timer(invalid_timer_id) {}
+
+	std::string as_string() const {
+		message_policy_t mpolicy = policy();
 
-	std::string as_string() {
 		std::stringstream s;
 		s << std::boolalpha;
 		s << "service: "<< path().service_alias << ", handle: ";
 		s << path().handle_name + "\n";
         s << "uuid: " << uuid.as_human_readable_string() << "\n";
-        s << "policy [urgent]: " << policy.urgent << "\n";
-        s << "policy [persistent]: " << policy.persistent << "\n";
-        s << "policy [timeout]: " << policy.timeout << "\n";
-        s << "policy [deadline]: " << policy.deadline << "\n";
-        s << "policy [max retries]: " << policy.max_retries << "\n";
-        s << "data_size: " << data_size << "\n";
-        s << "enqued timestamp: " << enqued_timestamp.as_string();
+        s << "policy [urgent]: " << mpolicy.urgent << "\n";
+        s << "policy [persistent]: " << mpolicy.persistent << "\n";
+        s << "policy [timeout]: " << mpolicy.timeout << "\n";
+        s << "policy [deadline]: " << mpolicy.deadline << "\n";
+        s << "policy [max retries]: " << mpolicy.max_retries << "\n";
+        s << "enqued timestamp: " << enqued_timestamp().as_string();
         return s.str();
 	}
 
 	const message_path_t& path() const {
-		return path_.get();
+		return intern_table_t<message_path_t>::get(path_id);
 	}
 
 	void set_path(const message_path_t& path) {
-		path_ = path;
+		path_id = intern_table_t<message_path_t>::intern(path);
+	}
+
+	message_policy_t policy() const {
+		return message_policy_t(flag(RMF_URGENT),
+								flag(RMF_PERSISTENT),
+								policy_timeout,
+								policy_ack_timeout,
+								policy_deadline,
+								policy_max_retries);
+	}
+
+	void set_policy(const message_policy_t& policy) {
+		set_flag(RMF_URGENT, policy.urgent);
+		set_flag(RMF_PERSISTENT, policy.persistent);
+		policy_timeout = policy.timeout;
+		policy_ack_timeout = policy.ack_timeout;
+		policy_deadline = policy.deadline;
+		policy_max_retries = policy.max_retries;
+	}
+
+	// endpoint ids come from cocaine_endpoint_t::endpoint_id
+	const std::string& destination_endpoint() const {
+		return intern_table_t<std::string>::get(endpoint_id);
+	}
+
+	// wall time of enqueue, server deadline is based on it
+	time_value enqued_timestamp() const {
+		return monotonic_clock_t::to_wall_time(enqued_at);
+	}
+
+	bool flag(boost::uint8_t mask) const {
+		return (flags & mask) != 0;
+	}
+
+	void set_flag(boost::uint8_t mask, bool value) {
+		if (value) {
+			flags |= mask;
+		}
+		else {
+			flags &= ~mask;
+		}
 	}
 
 	wuuid_t				uuid;
-	message_policy_t	policy;
-	std::string			destination_endpoint;
-	uint64_t			data_size;
+	intern_id_t			path_id;
+	intern_id_t			endpoint_id;
 
-	time_value	enqued_timestamp;
-	time_value	sent_timestamp;
-	bool		ack_received;
-	bool        ack_timed_out;
-	bool        deadlined;
+	// policy seconds, message_policy_t compares them as floats already
+	float				policy_timeout;
+	float				policy_ack_timeout;
+	float				policy_deadline;
+	boost::int32_t		policy_max_retries;
 
-	bool	is_sent;
-	int		retries_count;
+	boost::uint16_t		retries_count;
+	boost::uint8_t		flags;
 
-private:
-	boost::flyweight<message_path_t> path_;
+	// monotonic times
+	nanoseconds_t	enqued_at;
+	nanoseconds_t	sent_at;
+
+	// timer wheel entries, not persisted
+	timer_id_t	deadline_timer;
+	timer_id_t	ack_timer;
 };
 
+BOOST_STATIC_ASSERT(offsetof(request_metadata_t, deadline_timer) == 64);
+BOOST_STATIC_ASSERT(sizeof(request_metadata_t) == 80);
+
 struct persistent_request_metadata_t : public request_metadata_t {
 	persistent_request_metadata_t() :
-		request_metadata_t() {}
-
-	virtual ~persistent_request_metadata_t() {}
+		request_metadata_t(),
+		data_size(0) {}
 
 	void set_eblob(const boost::shared_ptr<eblob_t>& blob_) {
 		blob = blob_;
@@ -116,16 +187,21 @@ struct persistent_request_metadata_t : public request_metadata_t {
 
 		message_path_t path;
 		unpack_next_value(pac, path);
-		path = path;
+		set_path(path);
 
+		message_policy_t policy;
 		unpack_next_value(pac, policy);
+		set_policy(policy);
 
 		std::string tmp_uuid;
 		unpack_next_value(pac, tmp_uuid);
 		uuid = wuuid_t(tmp_uuid);
 
 		unpack_next_value(pac, data_size);
+
+		time_value enqued_timestamp;
 		unpack_next_value(pac, enqued_timestamp);
+		enqued_at = monotonic_clock_t::from_wall_time(enqued_timestamp);
 	}
 
 	void commit_data() {
@@ -133,15 +209,18 @@ struct persistent_request_metadata_t : public request_metadata_t {
 		msgpack::sbuffer buffer;
 		msgpack::packer<msgpack::sbuffer> pk(&buffer);
     	pk.pack(path());
-    	pk.pack(policy);
+    	pk.pack(policy());
     	pk.pack(uuid.as_string());
     	pk.pack(data_size);
-    	pk.pack(enqued_timestamp);
+    	pk.pack(enqued_timestamp());
 
     	// write to eblob_t with uuid as key
 		blob->write(uuid.as_string(), buffer.data(), buffer.size(), EBLOB_COLUMN);
 	}
 
+	// in-memory messages take size from data container
+	uint64_t data_size;
+
 private:
 	template<typename T> void unpack_next_value(msgpack::unpacker& upack, T& value) {
 	 	msgpack::unpacked result;
@@ -152,12 +231,12 @@ private:
 	boost::shared_ptr<eblob_t> blob;
 };
 
-std::ostream& operator << (std::ostream& out, request_metadata_t& req_meta) {
+inline std::ostream& operator << (std::ostream& out, request_metadata_t& req_meta) {
 	out << req_meta.as_string();
 	return out;
 }
 
-std::ostream& operator << (std::ostream& out, persistent_request_metadata_t& req_meta) {
+inline std::ostream& operator << (std::ostream& out, persistent_request_metadata_t& req_meta) {
 	out << req_meta.as_string();
 	return out;
 }
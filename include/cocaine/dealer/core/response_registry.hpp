@@ -0,0 +1,95 @@
+/*
+    Copyright (c) 2011-2012 Rim Zaidullin <creator@bash.org.ru>
+    Copyright (c) 2011-2012 Other contributors as noted in the AUTHORS file.
+
+    This file is part of Cocaine.
+
+    Cocaine is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Cocaine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>. 
+*/
+
+#ifndef _COCAINE_DEALER_RESPONSE_REGISTRY_HPP_INCLUDED_
+#define _COCAINE_DEALER_RESPONSE_REGISTRY_HPP_INCLUDED_
+
+#include <cstring>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/weak_ptr.hpp>
+#include <boost/enable_shared_from_this.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/utility.hpp>
+
+#include "cocaine/dealer/forwards.hpp"
+#include "cocaine/dealer/response_chunk.hpp"
+#include "cocaine/dealer/utils/uuid.hpp"
+
+namespace cocaine {
+namespace dealer {
+
+// responses awaiting chunks, keyed by raw uuid and split into shards
+// with own locks, entry is removed on final chunk or when caller
+// releases the response, responses with callbacks are held until final
+// chunk as caller does not keep them
+class response_registry_t :
+	private boost::noncopyable,
+	public boost::enable_shared_from_this<response_registry_t>
+{
+public:
+	typedef boost::shared_ptr<response_t> response_ptr_t;
+
+public:
+	response_registry_t();
+	virtual ~response_registry_t();
+
+	void add(const wuuid_t& uuid, const response_ptr_t& response);
+	void remove(const wuuid_t& uuid);
+
+	// response awaiting chunk, CHOKE and ERROR chunks end the response
+	// and remove it from registry
+	response_ptr_t response_for(const boost::shared_ptr<response_chunk_t>& chunk);
+
+	size_t size();
+
+	// ids of all responses still awaiting chunks
+	void pending_uuids(std::vector<wuuid_t>& uuids);
+
+private:
+	struct entry_t {
+		boost::weak_ptr<response_t>	response;
+
+		// set for responses with callbacks
+		response_ptr_t				held_response;
+	};
+
+	typedef boost::unordered_map<wuuid_t, entry_t, wuuid_hash_t> responses_map_t;
+
+	struct shard_t {
+		boost::mutex	mutex;
+		responses_map_t	responses;
+	};
+
+	static const size_t shards_count = 64;
+
+	shard_t& shard_for(const wuuid_t& uuid);
+
+private:
+	shard_t m_shards[shards_count];
+};
+
+} // namespace dealer
+} // namespace cocaine
+
+#endif // _COCAINE_DEALER_RESPONSE_REGISTRY_HPP_INCLUDED_
@@ -0,0 +1,149 @@
+/*
+    Copyright (c) 2011-2012 Rim Zaidullin <creator@bash.org.ru>
+    Copyright (c) 2011-2012 Other contributors as noted in the AUTHORS file.
+
+    This file is part of Cocaine.
+
+    Cocaine is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Cocaine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>. 
+*/
+
+#ifndef _COCAINE_DEALER_SENT_MESSAGES_INDEX_HPP_INCLUDED_
+#define _COCAINE_DEALER_SENT_MESSAGES_INDEX_HPP_INCLUDED_
+
+#include <string>
+#include <vector>
+#include <map>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/utility.hpp>
+#include <boost/cstdint.hpp>
+
+#include "cocaine/dealer/core/dispatch_message.hpp"
+#include "cocaine/dealer/utils/uuid.hpp"
+
+namespace cocaine {
+namespace dealer {
+
+// open addressing hash table of sent messages keyed by raw uuid bytes,
+// messages of the same route are linked into intrusive lists, route
+// strings are interned and compared once per lookup
+class sent_messages_index_t : private boost::noncopyable {
+public:
+	typedef dispatch_message_ptr_t message_ptr_t;
+	typedef boost::uint32_t route_id_t;
+
+public:
+	sent_messages_index_t();
+	virtual ~sent_messages_index_t();
+
+	size_t size() const;
+	size_t route_size(const std::string& route) const;
+
+	void insert(const std::string& route, const message_ptr_t& message);
+	bool find(const std::string& route, const wuuid_t& uuid, message_ptr_t& message) const;
+	bool erase(const std::string& route, const wuuid_t& uuid, message_ptr_t& message);
+	bool erase(const wuuid_t& uuid);
+
+	// remove messages and append them to container
+	template<typename Container> void extract_route(const std::string& route, Container& messages);
+	template<typename Container> void extract_all(Container& messages);
+
+	// <route, messages count> for non-empty routes
+	void routes_stats(std::vector<std::pair<std::string, size_t> >& stats) const;
+
+private:
+	static const size_t npos = static_cast<size_t>(-1);
+	static const size_t min_capacity = 64;
+
+	enum e_slot_state {
+		SLOT_EMPTY = 0,
+		SLOT_FULL,
+		SLOT_DELETED
+	};
+
+	struct slot_t {
+		slot_t() :
+			state(SLOT_EMPTY),
+			route(0),
+			prev(npos),
+			next(npos) {}
+
+		unsigned char	uuid[wuuid_t::UUID_SIZE];
+		unsigned char	state;
+		route_id_t		route;
+
+		// route list links
+		size_t prev;
+		size_t next;
+
+		message_ptr_t message;
+	};
+
+	struct route_t {
+		route_t() :
+			head(npos),
+			count(0) {}
+
+		std::string	name;
+		size_t		head;
+		size_t		count;
+	};
+
+	static size_t hash(const unsigned char* uuid);
+
+	bool find_route(const std::string& route, route_id_t& id) const;
+	route_id_t intern_route(const std::string& route);
+
+	size_t find_slot(const unsigned char* uuid) const;
+	void place(route_id_t route, const unsigned char* uuid, const message_ptr_t& message);
+	void remove_slot(size_t index);
+	void rehash(size_t capacity);
+
+private:
+	std::vector<slot_t>	m_slots;
+	size_t				m_size;
+	size_t				m_deleted;
+
+	std::map<std::string, route_id_t>	m_route_ids;
+	std::vector<route_t>				m_routes;
+};
+
+template<typename Container> void
+sent_messages_index_t::extract_route(const std::string& route, Container& messages) {
+	route_id_t id;
+	if (!find_route(route, id)) {
+		return;
+	}
+
+	while (m_routes[id].head != npos) {
+		size_t index = m_routes[id].head;
+		messages.push_back(m_slots[index].message);
+		remove_slot(index);
+	}
+}
+
+template<typename Container> void
+sent_messages_index_t::extract_all(Container& messages) {
+	for (size_t i = 0; i < m_slots.size(); ++i) {
+		if (m_slots[i].state == SLOT_FULL) {
+			messages.push_back(m_slots[i].message);
+			remove_slot(i);
+		}
+	}
+}
+
+} // namespace dealer
+} // namespace cocaine
+
+#endif // _COCAINE_DEALER_SENT_MESSAGES_INDEX_HPP_INCLUDED_
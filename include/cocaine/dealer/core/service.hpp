@@ -31,6 +31,7 @@
 #include <boost/shared_ptr.hpp>
 #include <boost/utility.hpp>
 #include <boost/thread/thread.hpp>
+#include <boost/thread/condition_variable.hpp>
 #include <boost/function.hpp>
 
 #include "cocaine/dealer/response.hpp"
@@ -40,13 +41,16 @@
 #include "cocaine/dealer/core/handle_info.hpp"
 #include "cocaine/dealer/core/service_info.hpp"
 #include "cocaine/dealer/core/dealer_object.hpp"
-#include "cocaine/dealer/core/message_iface.hpp"
+#include "cocaine/dealer/core/dispatch_message.hpp"
 #include "cocaine/dealer/core/cocaine_endpoint.hpp"
+#include "cocaine/dealer/core/response_registry.hpp"
+#include "cocaine/dealer/core/callback_executor.hpp"
 
 #include "cocaine/dealer/utils/error.hpp"
 #include "cocaine/dealer/utils/smart_logger.hpp"
-#include "cocaine/dealer/utils/refresher.hpp"
 #include "cocaine/dealer/utils/progress_timer.hpp"
+#include "cocaine/dealer/utils/timer_wheel.hpp"
+#include "cocaine/dealer/utils/shared_snapshot.hpp"
 
 #include "cocaine/dealer/storage/eblob.hpp"
 
@@ -59,8 +63,9 @@ public:
 
 	typedef boost::shared_ptr<handle_t> handle_ptr_t;
 	typedef std::map<std::string, handle_ptr_t> handles_map_t;
+	typedef shared_snapshot_t<handles_map_t>::snapshot_ptr_t handles_snapshot_ptr_t;
 
-	typedef boost::shared_ptr<message_iface> cached_message_prt_t;
+	typedef dispatch_message_ptr_t cached_message_prt_t;
 
 	typedef std::deque<cached_message_prt_t> cached_messages_deque_t;
 	typedef boost::shared_ptr<cached_messages_deque_t> messages_deque_ptr_t;
@@ -80,6 +85,14 @@ public:
 	void destroy_handle(const handle_info_t& handle_info);
 
 	boost::shared_ptr<response_t> send_message(cached_message_prt_t message);
+
+	void send_message(cached_message_prt_t message,
+					  const response_chunk_callback_t& on_chunk,
+					  const response_complete_callback_t& on_complete);
+
+	// responses are appended in messages order
+	void send_messages(const std::vector<cached_message_prt_t>& messages,
+					   std::vector<boost::shared_ptr<response_t> >& responses);
 	bool is_dead();
 
 	service_info_t info() const;
@@ -89,7 +102,19 @@ private:
 
 	void enqueue_responce(boost::shared_ptr<response_chunk_t>& response);
 
+	// sleeps until next unhandled message deadline or until signalled
+	void process_deadlines();
 	void check_for_deadlined_messages();
+	void arm_deadline_timer(const cached_message_prt_t& message);
+
+	// answers every message service still owes a response with error,
+	// called on shutdown once no handle can deliver chunks
+	void fail_unhandled_messages();
+	void fail_pending_responses();
+	void enqueue_error(const wuuid_t& uuid, int error_code, const std::string& error_message);
+
+	// drop deadlined messages left in unhandled queue, m_unhandled_mutex must be held
+	static void compact_unhandled_queue(cached_messages_deque_t& queue);
 
 	bool enque_to_handle(const cached_message_prt_t& message);
 	void enque_to_unhandled(const cached_message_prt_t& message);
@@ -105,6 +130,10 @@ private:
 
 	messages_deque_ptr_t get_and_remove_unhandled_queue(const std::string& handle_name);
 
+	// copy handles map for lock-free readers, m_handles_mutex must be held
+	void publish_handles();
+	handle_ptr_t find_handle(const std::string& handle_name) const;
+
 private:
 	// service information
 	service_info_t m_info;
@@ -112,24 +141,33 @@ private:
 	// handles map (handle name, handle ptr)
 	handles_map_t m_handles;
 
+	// immutable copy of m_handles for send path
+	shared_snapshot_t<handles_map_t> m_handles_snapshot;
+
 	// service messages for non-existing handles <handle name, handle ptr>
 	unhandled_messages_map_t m_unhandled_messages;
 
-	// responces map <uuid, response_t>
-	std::map<std::string, boost::shared_ptr<response_t> > m_responses;
+	// deadlines of unhandled messages, guarded by m_unhandled_mutex
+	timer_wheel_t<cached_message_prt_t> m_unhandled_timers;
+
+	// deadlined messages still sitting in unhandled queues <handle name, count>
+	std::map<std::string, size_t> m_unhandled_expired;
+
+	// responses awaiting chunks
+	boost::shared_ptr<response_registry_t> m_responses;
+
+	// runs response callbacks, empty to run them on reactor threads
+	boost::shared_ptr<callback_executor_t> m_callback_executor;
 
-	boost::mutex				m_responces_mutex;
 	boost::mutex				m_handles_mutex;
 	boost::mutex				m_unhandled_mutex;
 
 	volatile bool m_is_running;
 
-	// deadlined messages refresher
-	std::auto_ptr<refresher> m_deadlined_messages_refresher;
-
-	static const int deadline_check_interval = 1000; // millisecs
-
-	progress_timer m_responces_cleanup_timer;
+	// deadline thread waits on it, guarded by m_unhandled_mutex
+	boost::condition_variable	m_deadlines_cond;
+	nanoseconds_t				m_deadlines_wakeup;
+	boost::thread				m_deadlines_thread;
 
 	bool m_is_dead;
 };
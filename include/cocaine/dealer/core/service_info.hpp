@@ -33,10 +33,13 @@ namespace dealer {
 
 struct service_info_t {
 public:	
-	service_info_t() : discovery_type(AT_UNDEFINED) {};
+	service_info_t() :
+		discovery_type(AT_UNDEFINED),
+		balancing_type(defaults_t::balancing_type) {};
 	
 	service_info_t(const service_info_t& info) : 
-		discovery_type(AT_UNDEFINED)
+		discovery_type(AT_UNDEFINED),
+		balancing_type(defaults_t::balancing_type)
 	{
 		*this = info;
 	}
@@ -50,7 +53,8 @@ public:
 					  description(description),
 					  app(app),
 					  hosts_source(hosts_source),
-					  discovery_type(discovery_type) {}
+					  discovery_type(discovery_type),
+					  balancing_type(defaults_t::balancing_type) {}
 	
 	bool operator == (const service_info_t& rhs) {
 		return (name == rhs.name &&
@@ -85,6 +89,16 @@ public:
 				break;
 		}
 
+		switch (balancing_type) {
+			case BT_ROUND_ROBIN:
+				out << "balancing type: round robin\n";
+				break;
+
+			case BT_LEAST_OUTSTANDING:
+				out << "balancing type: least outstanding\n";
+				break;
+		}
+
 		return out.str();
 	}
 
@@ -98,6 +112,9 @@ public:
 	enum e_autodiscovery_type discovery_type;
 	short default_discovery_port;
 
+	// endpoint selection
+	enum e_balancing_type balancing_type;
+
 	// default service message policy
 	message_policy_t policy;
 };
@@ -22,12 +22,14 @@
 #define _COCAINE_DEALER_CLIENT_HPP_INCLUDED_
 
 #include <string>
+#include <memory>
 
 #include <boost/utility.hpp>
 #include <boost/shared_ptr.hpp>
 
 #include <cocaine/dealer/message.hpp>
 #include <cocaine/dealer/response.hpp>
+#include <cocaine/dealer/completion_queue.hpp>
 #include <cocaine/dealer/utils/data_container.hpp>
 #include <cocaine/dealer/message_path.hpp>
 #include <cocaine/dealer/message_policy.hpp>
@@ -90,7 +92,43 @@ public:
 	send_messages(const std::string& data,
 				  const message_path_t& path);
 
-	// send any object supported by msgpack library
+	// send string taking over its memory, no payload copy
+	response_ptr_t
+	send_message(std::string&& data,
+				 const message_path_t& path,
+				 const message_policy_t& policy);
+
+	response_ptr_t
+	send_message(std::string&& data,
+				 const message_path_t& path);
+
+	// send packed data taking over buffer memory, buffer is left empty
+	response_ptr_t
+	send_message(msgpack::sbuffer& buffer,
+				 const message_path_t& path,
+				 const message_policy_t& policy);
+
+	response_ptr_t
+	send_message(msgpack::sbuffer& buffer,
+				 const message_path_t& path);
+
+	// send data taking over caller's buffer, deleter frees it once
+	// the message is gone
+	template <typename T, typename D> response_ptr_t
+	send_message(std::unique_ptr<T, D> data,
+				 size_t size,
+				 const message_path_t& path,
+				 const message_policy_t& policy)
+	{
+		D deleter = data.get_deleter();
+		typename std::unique_ptr<T, D>::pointer ptr = data.release();
+		boost::shared_ptr<void> owner(ptr, deleter);
+
+		return send_shared_data(data_container(ptr, size, owner), path, policy);
+	}
+
+	// send any object supported by msgpack library, object is packed
+	// right into memory owned by the message
 	template <typename T> response_ptr_t
 	send_message(const T& object,
 				 const message_path_t& path,
@@ -98,7 +136,7 @@ public:
 	{
 		msgpack::sbuffer buffer;
 		msgpack::pack(buffer, object);
-		return send_message(reinterpret_cast<const void*>(buffer.data()), buffer.size(), path, policy);
+		return send_message(buffer, path, policy);
 	}
 
 	template <typename T> response_ptr_t
@@ -107,9 +145,64 @@ public:
 	{
 		msgpack::sbuffer buffer;
 		msgpack::pack(buffer, object);
-		return send_message(reinterpret_cast<const void*>(buffer.data()), buffer.size(), path);
+		return send_message(buffer, path);
 	}
 
+	// send message and get response chunks through callbacks,
+	// on_complete is called once, with zero error code on success
+	void
+	send_message(const void* data,
+				 size_t size,
+				 const message_path_t& path,
+				 const message_policy_t& policy,
+				 const response_chunk_callback_t& on_chunk,
+				 const response_complete_callback_t& on_complete);
+
+	void
+	send_message(const std::string& data,
+				 const message_path_t& path,
+				 const message_policy_t& policy,
+				 const response_chunk_callback_t& on_chunk,
+				 const response_complete_callback_t& on_complete);
+
+	// send message and get response events on completion queue,
+	// events carry the tag to tell requests apart
+	void
+	send_message(const void* data,
+				 size_t size,
+				 const message_path_t& path,
+				 const message_policy_t& policy,
+				 const boost::shared_ptr<completion_queue_t>& queue,
+				 boost::uint64_t tag);
+
+	void
+	send_message(const std::string& data,
+				 const message_path_t& path,
+				 const message_policy_t& policy,
+				 const boost::shared_ptr<completion_queue_t>& queue,
+				 boost::uint64_t tag);
+
+	// send payload gathered from segments, segments are copied once
+	// into the message
+	response_ptr_t
+	send_message(const struct iovec* segments,
+				 size_t count,
+				 const message_path_t& path,
+				 const message_policy_t& policy);
+
+	// same, but owner keeps segments memory alive until the message
+	// is gone, so a single segment is sent with no copy at all
+	response_ptr_t
+	send_message(const struct iovec* segments,
+				 size_t count,
+				 const boost::shared_ptr<void>& owner,
+				 const message_path_t& path,
+				 const message_policy_t& policy);
+
+	// send many messages at once, responses follow messages order
+	responses_list_t
+	send_messages_batch(const std::vector<message_t>& messages);
+
 	size_t stored_messages_count(const std::string& service_alias);
 	void remove_stored_message(const message_t& message);
 	void remove_stored_message_for(const response_ptr_t& response);
@@ -117,8 +210,18 @@ public:
 							 std::vector<message_t>& messages);
 
 	message_policy_t policy_for_service(const std::string& service_alias);
-	
+
 private:
+	// message shares data with container
+	response_ptr_t
+	send_shared_data(const data_container& data,
+					 const message_path_t& path,
+					 const message_policy_t& policy);
+
+	response_ptr_t
+	send_shared_data(const data_container& data,
+					 const message_path_t& path);
+
 	boost::shared_ptr<dealer_impl_t> m_impl;
 };
 
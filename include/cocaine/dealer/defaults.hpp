@@ -38,12 +38,25 @@ enum e_message_cache_type {
 	PERSISTENT
 };
 
+enum e_message_id_type {
+	MIT_UUID = 1,
+	MIT_SEQUENTIAL
+};
+
+enum e_balancing_type {
+	BT_ROUND_ROBIN = 1,
+	BT_LEAST_OUTSTANDING
+};
+
 struct defaults_t {
 	// common
 	static const int		protocol_version	= 1;
 	static const unsigned short	control_port	= 5001; // cocaine server announce port
 	static const size_t		max_message_size	= 2147483648; // 2 gb (in bytes)
 	static const float		endpoint_timeout;
+	static const unsigned int	reactor_threads		= 0; // one per cpu core
+	static const unsigned int	callback_threads	= 0; // invoke on reactor threads
+	static const enum e_message_id_type message_id_type = MIT_UUID;
 
 	// logger
 	static const enum e_logger_type	logger_type	= STDOUT_LOGGER;
@@ -57,6 +70,9 @@ struct defaults_t {
 	static const float 	policy_chunk_timeout;
 	static const float	policy_message_deadline;
 
+	// endpoint selection
+	static const enum e_balancing_type balancing_type = BT_ROUND_ROBIN;
+
 	// persistance
 	static const enum e_message_cache_type message_cache_type = RAM_ONLY;
 
@@ -31,6 +31,9 @@ class service_t;
 
 class response_t;
 class response_impl_t;
+class response_registry_t;
+
+class completion_queue_t;
 
 } // namespace dealer
 } // namespace cocaine
@@ -107,6 +107,9 @@ private:
 
 	void routing_table_from_responces(const std::map<std::string, cocaine_node_list_t>& parsed_responses,
 									  routing_table_t& routing_table);
+
+	// relative share of traffic app instance can take, derived from announced load
+	int endpoint_weight(const cocaine_node_app_info_t& app);
 	
 	void update_main_routing_table(routing_table_t& routing_table_update);
 
@@ -121,6 +124,10 @@ private:
 
 	void check_for_timedout_endpoints(ev::timer& timer, int type);
 	bool endpoints_set_equal(const endpoints_set_t& lhs, const endpoints_set_t& rhs);
+
+	// keeps published weights of surviving endpoints unless they moved noticeably
+	void apply_weight_hysteresis(endpoints_set_t& fresh, const endpoints_set_t& current);
+	bool weight_changed(int old_weight, int new_weight);
 	bool all_endpoints_dead(const endpoints_set_t& endpoints);
 	
 	void reset_routing_table(routing_table_t& routing_table);
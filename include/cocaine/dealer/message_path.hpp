@@ -72,8 +72,10 @@ struct message_path_t {
 };
 
 static std::size_t __attribute__ ((unused)) hash_value(const message_path_t& path) {
-    boost::hash<std::string> hasher;
-    return hasher(path.service_alias + path.handle_name);
+    std::size_t seed = 0;
+    boost::hash_combine(seed, path.service_alias);
+    boost::hash_combine(seed, path.handle_name);
+    return seed;
 }
 
 } // namespace dealer
@@ -24,6 +24,8 @@
 #include <string>
 
 #include <boost/shared_ptr.hpp>
+#include <boost/weak_ptr.hpp>
+#include <boost/function.hpp>
 
 #include <cocaine/dealer/forwards.hpp>
 #include <cocaine/dealer/utils/data_container.hpp>
@@ -34,6 +36,12 @@
 namespace cocaine {
 namespace dealer {
 
+// invoked for each received response chunk
+typedef boost::function<void(const data_container& chunk)> response_chunk_callback_t;
+
+// invoked once response is over, error_code is 0 on success
+typedef boost::function<void(int error_code, const std::string& error_message)> response_complete_callback_t;
+
 class response_t {
 public:
 	response_t(const wuuid_t& uuid, const message_path_t& path);
@@ -44,10 +52,24 @@ public:
 
 private:
 	friend class service_t;
+	friend class response_registry_t;
 
     void add_chunk(const boost::shared_ptr<response_chunk_t>& chunk);
 
+	// chunks go to callbacks instead of get()
+	void set_callbacks(const response_chunk_callback_t& on_chunk,
+					   const response_complete_callback_t& on_complete);
+
+	bool has_callbacks() const;
+
 	boost::shared_ptr<response_impl_t> m_impl;
+
+	response_chunk_callback_t		m_on_chunk;
+	response_complete_callback_t	m_on_complete;
+	bool							m_is_complete;
+
+	// registry to leave when released by caller
+	boost::weak_ptr<response_registry_t> m_registry;
 };
 
 } // namespace dealer
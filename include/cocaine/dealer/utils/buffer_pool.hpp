@@ -0,0 +1,179 @@
+/*
+    Copyright (c) 2011-2012 Rim Zaidullin <creator@bash.org.ru>
+    Copyright (c) 2011-2012 Other contributors as noted in the AUTHORS file.
+
+    This file is part of Cocaine.
+
+    Cocaine is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Cocaine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>. 
+*/
+
+#ifndef _COCAINE_DEALER_BUFFER_POOL_HPP_INCLUDED_
+#define _COCAINE_DEALER_BUFFER_POOL_HPP_INCLUDED_
+
+#include <cstddef>
+#include <new>
+
+#include <boost/utility.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/tss.hpp>
+
+namespace cocaine {
+namespace dealer {
+
+// refcounted buffers taken from power of two size classes, refcount lives
+// in a header in front of the data, released buffers are cached by
+// thread and spilled to shared lists when thread cache grows too big
+class buffer_pool_t : private boost::noncopyable {
+public:
+	// buffer with one reference
+	static unsigned char* allocate(size_t size);
+
+	// any thread
+	static void add_ref(unsigned char* data);
+	static void release(unsigned char* data);
+
+private:
+	struct block_t {
+		volatile int	refs;
+		unsigned int	size_class;
+		block_t*		next;
+	};
+
+	// keeps data 16 bytes aligned
+	static const size_t header_size = 16;
+
+	// 64 bytes to 1 mb blocks, larger ones are not pooled
+	static const size_t min_block_size = 64;
+	static const unsigned int size_classes_count = 15;
+	static const unsigned int unpooled_class = size_classes_count;
+
+	// cached blocks per thread and size class
+	static const size_t thread_cache_bytes = 256 * 1024;
+	static const size_t thread_cache_min_blocks = 4;
+
+	// blocks in shared lists per size class
+	static const size_t shared_cache_bytes = 4 * 1024 * 1024;
+	static const size_t shared_cache_min_blocks = 16;
+
+	struct free_list_t {
+		free_list_t() :
+			head(NULL),
+			count(0) {}
+
+		block_t*	head;
+		size_t		count;
+	};
+
+	struct thread_cache_t {
+		~thread_cache_t();
+
+		free_list_t lists[size_classes_count];
+	};
+
+	struct shared_list_t {
+		boost::mutex	mutex;
+		free_list_t		list;
+	};
+
+	buffer_pool_t();
+
+	static buffer_pool_t& instance();
+
+	static unsigned int size_class_for(size_t size);
+	static size_t block_size(unsigned int size_class);
+	static size_t cached_blocks_limit(size_t cache_bytes, size_t min_blocks, unsigned int size_class);
+
+	static block_t* block_of(unsigned char* data);
+	static unsigned char* data_of(block_t* block);
+
+	thread_cache_t* thread_cache();
+
+	block_t* take(unsigned int size_class);
+	void put(block_t* block);
+
+	// moves up to count blocks between thread and shared lists
+	void refill(free_list_t& list, unsigned int size_class, size_t count);
+	void spill(free_list_t& list, unsigned int size_class, size_t count);
+
+private:
+	shared_list_t m_shared[size_classes_count];
+	boost::thread_specific_ptr<thread_cache_t> m_thread_cache;
+};
+
+// standard allocator over pool blocks, lets boost::allocate_shared put
+// object and its control block into one recycled block
+template<typename T>
+class buffer_pool_allocator_t {
+public:
+	typedef T			value_type;
+	typedef T*			pointer;
+	typedef const T*	const_pointer;
+	typedef T&			reference;
+	typedef const T&	const_reference;
+	typedef size_t		size_type;
+	typedef ptrdiff_t	difference_type;
+
+	template<typename U>
+	struct rebind {
+		typedef buffer_pool_allocator_t<U> other;
+	};
+
+	buffer_pool_allocator_t() {}
+
+	template<typename U>
+	buffer_pool_allocator_t(const buffer_pool_allocator_t<U>&) {}
+
+	pointer address(reference value) const {
+		return &value;
+	}
+
+	const_pointer address(const_reference value) const {
+		return &value;
+	}
+
+	pointer allocate(size_type n, const void* = 0) {
+		return reinterpret_cast<pointer>(buffer_pool_t::allocate(n * sizeof(T)));
+	}
+
+	void deallocate(pointer p, size_type) {
+		buffer_pool_t::release(reinterpret_cast<unsigned char*>(p));
+	}
+
+	size_type max_size() const {
+		return static_cast<size_type>(-1) / sizeof(T);
+	}
+
+	void construct(pointer p, const T& value) {
+		new (p) T(value);
+	}
+
+	void destroy(pointer p) {
+		p->~T();
+	}
+};
+
+template<typename T, typename U>
+bool operator == (const buffer_pool_allocator_t<T>&, const buffer_pool_allocator_t<U>&) {
+	return true;
+}
+
+template<typename T, typename U>
+bool operator != (const buffer_pool_allocator_t<T>&, const buffer_pool_allocator_t<U>&) {
+	return false;
+}
+
+} // namespace dealer
+} // namespace cocaine
+
+#endif // _COCAINE_DEALER_BUFFER_POOL_HPP_INCLUDED_
@@ -24,20 +24,29 @@
 #include <string>
 #include <cstring>
 #include <sys/time.h>
+#include <sys/uio.h>
 
+#include <boost/cstdint.hpp>
 #include <boost/shared_ptr.hpp>
-#include <boost/detail/atomic_count.hpp>
 
 namespace cocaine {
 namespace dealer {
 
+// payloads up to INLINE_DATA_SIZE bytes are kept inside the container,
+// bigger ones in pooled refcounted buffers shared by copies
 class data_container {
 
 public:
 	data_container();
 	data_container(const void* data, size_t size);
+
+	// view of memory owned by someone else, owner is kept alive
+	// by the view and all of it's copies, data is not copied
+	// unless it fits inline
+	data_container(const void* data, size_t size, const boost::shared_ptr<void>& owner);
+
 	data_container(const data_container& dc);
-	virtual ~data_container();
+	~data_container();
 	
 	data_container& operator = (const data_container& rhs);
 	bool operator == (const data_container& rhs) const;
@@ -45,11 +54,26 @@ public:
 
 	void set_data(const void* data, size_t size);
 
+	// gathers segments into one buffer with a single copy
+	void set_data(const struct iovec* segments, size_t count);
+
 	void* data() const;
 	size_t size() const;
 	bool empty() const;
 	void clear();
 
+	// refcounted storage of loaded data, copies share the same memory
+	const data_container& buffer() const;
+
+	// extra reference to pooled data for zero-copy consumers, false
+	// for inline data and views of memory owned by someone else
+	bool retain_buffer() const;
+
+	bool is_inline() const;
+
+	// drops reference taken with retain_buffer(), any thread
+	static void release_buffer(void* data);
+
 	bool is_data_loaded();
 	void load_data();
 	void unload_data();
@@ -57,33 +81,35 @@ public:
 	void remove_from_persistent_cache();
 
 protected:
-	// sha1 size in bytes
-	static const size_t SHA1_SIZE = 20;
-
-	// sha1-encoded data chunk size - 512 kb
-	static const size_t SHA1_CHUNK_SIZE = 512 * 1024;
-
-	// max amount of data that does not need sha1 signature 1 mb
+	// max amount of data that is compared without signature 1 mb
 	static const size_t SMALL_DATA_SIZE = 1024 * 1024;
 
-	typedef boost::detail::atomic_count reference_counter;
-	
+	// container takes two cache lines on 64-bit platforms
+	static const size_t INLINE_DATA_SIZE = 88;
+
 	void init();
 	void release();
 
-	void sign_data(unsigned char* data, size_t& size, unsigned char signature[SHA1_SIZE]);
+	// xxhash64 of data, computed on first comparison
+	boost::uint64_t signature() const;
 
 protected:
-	// data
+	// data, points to inline storage, pooled buffer with inline
+	// reference counter or viewed memory if owner_ is set
 	unsigned char* data_;
 	size_t size_;
 
-	// data sha1 signature
-	bool signed_;
-	unsigned char signature_[SHA1_SIZE];
+	// owner of viewed memory (data_ is not ours then)
+	boost::shared_ptr<void> owner_;
+
+	// signature is valid once set
+	mutable volatile int signed_;
 
-	// data reference counter
-	boost::shared_ptr<reference_counter> ref_counter_;
+	// only big data is signed, so signature shares space with small data
+	mutable union {
+		boost::uint64_t	signature;
+		unsigned char	bytes[INLINE_DATA_SIZE];
+	} storage_;
 };
 
 } // namespace dealer
@@ -0,0 +1,56 @@
+/*
+    Copyright (c) 2011-2012 Rim Zaidullin <creator@bash.org.ru>
+    Copyright (c) 2011-2012 Other contributors as noted in the AUTHORS file.
+
+    This file is part of Cocaine.
+
+    Cocaine is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Cocaine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>. 
+*/
+
+#ifndef _COCAINE_DEALER_ID_GENERATOR_HPP_INCLUDED_
+#define _COCAINE_DEALER_ID_GENERATOR_HPP_INCLUDED_
+
+#include <boost/cstdint.hpp>
+
+namespace cocaine {
+namespace dealer {
+
+// makes 16 byte message ids, either random with libuuid or sequential,
+// sequential ids are a random per process prefix followed by a block
+// number taken once per thread and a counter within the block, so they
+// take no syscalls or locks and never repeat across restarts
+class id_generator_t {
+public:
+	static const int ID_SIZE = 16;
+
+	// process-wide, random ids by default
+	static void set_sequential(bool sequential);
+
+	// any thread
+	static void generate(unsigned char id[ID_SIZE]);
+
+private:
+	static void generate_sequential(unsigned char id[ID_SIZE]);
+	static void init_process_prefix();
+
+private:
+	static volatile int m_sequential;
+	static boost::uint64_t m_process_prefix;
+	static volatile boost::uint32_t m_last_block;
+};
+
+} // namespace dealer
+} // namespace cocaine
+
+#endif // _COCAINE_DEALER_ID_GENERATOR_HPP_INCLUDED_
@@ -0,0 +1,135 @@
+/*
+    Copyright (c) 2011-2012 Rim Zaidullin <creator@bash.org.ru>
+    Copyright (c) 2011-2012 Other contributors as noted in the AUTHORS file.
+
+    This file is part of Cocaine.
+
+    Cocaine is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Cocaine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>. 
+*/
+
+#ifndef _COCAINE_DEALER_INTERN_TABLE_HPP_INCLUDED_
+#define _COCAINE_DEALER_INTERN_TABLE_HPP_INCLUDED_
+
+#include <cstring>
+
+#include <boost/cstdint.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/functional/hash.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include "cocaine/dealer/utils/error.hpp"
+
+namespace cocaine {
+namespace dealer {
+
+typedef boost::uint32_t intern_id_t;
+
+// gives small stable ids to values repeated across many messages (paths,
+// endpoints), id 0 is the default value, values are never released, so
+// only values from a bounded set belong here; lookup by id takes no lock,
+// interning checks a small per-thread cache before taking the table lock
+template<typename T>
+class intern_table_t : private boost::noncopyable {
+public:
+	// leaked on purpose, ids may be looked up during static destruction
+	static intern_table_t& instance() {
+		static intern_table_t* table = new intern_table_t();
+		return *table;
+	}
+
+	static intern_id_t intern(const T& value) {
+		return instance().intern_value(value);
+	}
+
+	static const T& get(intern_id_t id) {
+		return instance().value(id);
+	}
+
+	const T& value(intern_id_t id) const {
+		return m_chunks[id >> CHUNK_BITS][id & (CHUNK_SIZE - 1)];
+	}
+
+	intern_id_t intern_value(const T& value) {
+		size_t hash = boost::hash<T>()(value);
+		intern_id_t& cached = m_thread_cache[hash & (THREAD_CACHE_SIZE - 1)];
+
+		// cache keeps id + 1, zero is an empty slot
+		if (cached != 0 && this->value(cached - 1) == value) {
+			return cached - 1;
+		}
+
+		boost::mutex::scoped_lock lock(m_mutex);
+		intern_id_t id = insert(value);
+		cached = id + 1;
+
+		return id;
+	}
+
+private:
+	static const intern_id_t CHUNK_BITS = 8;
+	static const intern_id_t CHUNK_SIZE = 1 << CHUNK_BITS;
+	static const intern_id_t MAX_CHUNKS = 4096;
+	static const size_t THREAD_CACHE_SIZE = 8;
+
+	intern_table_t() : m_size(0) {
+		memset(m_chunks, 0, sizeof(m_chunks));
+		insert(T());
+	}
+
+	intern_id_t insert(const T& value) {
+		typename index_t::iterator it = m_index.find(value);
+
+		if (it != m_index.end()) {
+			return it->second;
+		}
+
+		intern_id_t id = m_size;
+
+		if ((id >> CHUNK_BITS) >= MAX_CHUNKS) {
+			throw internal_error("intern table is full");
+		}
+
+		if (!m_chunks[id >> CHUNK_BITS]) {
+			m_chunks[id >> CHUNK_BITS] = new T[CHUNK_SIZE];
+		}
+
+		// publish value before its id can reach other threads
+		m_chunks[id >> CHUNK_BITS][id & (CHUNK_SIZE - 1)] = value;
+		__sync_synchronize();
+
+		m_index[value] = id;
+		++m_size;
+
+		return id;
+	}
+
+private:
+	typedef boost::unordered_map<T, intern_id_t, boost::hash<T> > index_t;
+
+	T*					m_chunks[MAX_CHUNKS];
+	intern_id_t			m_size;
+	index_t				m_index;
+	boost::mutex		m_mutex;
+
+	static __thread intern_id_t m_thread_cache[THREAD_CACHE_SIZE];
+};
+
+template<typename T> __thread intern_id_t
+intern_table_t<T>::m_thread_cache[intern_table_t<T>::THREAD_CACHE_SIZE];
+
+} // namespace dealer
+} // namespace cocaine
+
+#endif // _COCAINE_DEALER_INTERN_TABLE_HPP_INCLUDED_
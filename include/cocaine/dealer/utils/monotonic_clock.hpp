@@ -0,0 +1,61 @@
+/*
+    Copyright (c) 2011-2012 Rim Zaidullin <creator@bash.org.ru>
+    Copyright (c) 2011-2012 Other contributors as noted in the AUTHORS file.
+
+    This file is part of Cocaine.
+
+    Cocaine is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Cocaine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>. 
+*/
+
+#ifndef _COCAINE_DEALER_MONOTONIC_CLOCK_HPP_INCLUDED_
+#define _COCAINE_DEALER_MONOTONIC_CLOCK_HPP_INCLUDED_
+
+#include <boost/cstdint.hpp>
+
+#include <cocaine/dealer/utils/time_value.hpp>
+
+namespace cocaine {
+namespace dealer {
+
+typedef boost::uint64_t nanoseconds_t;
+
+// internal clock for timeouts and latencies, nanoseconds from an arbitrary
+// point, does not jump with wall clock, coarse (a few ms) since it is read
+// through vdso with no syscall
+class monotonic_clock_t {
+public:
+	static const nanoseconds_t nanoseconds_per_millisecond = 1000000ULL;
+	static const nanoseconds_t nanoseconds_per_second = 1000000000ULL;
+
+	static nanoseconds_t now();
+
+	// time of the current dispatch loop iteration on calling thread,
+	// loops read clock once per iteration with refresh(), other threads
+	// get now()
+	static nanoseconds_t loop_now();
+	static nanoseconds_t refresh();
+
+	static nanoseconds_t from_seconds(double seconds);
+	static double to_seconds(nanoseconds_t interval);
+
+	// conversion of past moments to wall time and back, for logging
+	// and persistent messages
+	static time_value to_wall_time(nanoseconds_t time);
+	static nanoseconds_t from_wall_time(const time_value& time);
+};
+
+} // namespace dealer
+} // namespace cocaine
+
+#endif // _COCAINE_DEALER_MONOTONIC_CLOCK_HPP_INCLUDED_
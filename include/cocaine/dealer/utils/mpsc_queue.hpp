@@ -0,0 +1,139 @@
+/*
+    Copyright (c) 2011-2012 Rim Zaidullin <creator@bash.org.ru>
+    Copyright (c) 2011-2012 Other contributors as noted in the AUTHORS file.
+
+    This file is part of Cocaine.
+
+    Cocaine is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Cocaine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>. 
+*/
+
+#ifndef _COCAINE_DEALER_MPSC_QUEUE_HPP_INCLUDED_
+#define _COCAINE_DEALER_MPSC_QUEUE_HPP_INCLUDED_
+
+#include <cstddef>
+#include <vector>
+#include <algorithm>
+
+#include <boost/utility.hpp>
+
+namespace cocaine {
+namespace dealer {
+
+// lock-free multiple producers single consumer queue, producers push
+// onto a stack with cas, consumer takes the whole stack at once and
+// restores push order
+template<typename T>
+class mpsc_queue_t : private boost::noncopyable {
+public:
+	mpsc_queue_t() :
+		m_head(NULL) {}
+
+	virtual ~mpsc_queue_t() {
+		release(m_head);
+	}
+
+	// any thread
+	void push(const T& value) {
+		node_t* node = new node_t(value);
+		node_t* head = m_head;
+
+		while (true) {
+			node->next = head;
+			node_t* seen = __sync_val_compare_and_swap(&m_head, head, node);
+
+			if (seen == head) {
+				break;
+			}
+
+			head = seen;
+		}
+	}
+
+	// any thread, all values with a single cas
+	template<typename Iterator> void push(Iterator begin, Iterator end) {
+		if (begin == end) {
+			return;
+		}
+
+		node_t* tail = new node_t(*begin);
+		node_t* first = tail;
+
+		for (++begin; begin != end; ++begin) {
+			node_t* node = new node_t(*begin);
+			node->next = first;
+			first = node;
+		}
+
+		node_t* head = m_head;
+
+		while (true) {
+			tail->next = head;
+			node_t* seen = __sync_val_compare_and_swap(&m_head, head, first);
+
+			if (seen == head) {
+				break;
+			}
+
+			head = seen;
+		}
+	}
+
+	bool empty() const {
+		return m_head == NULL;
+	}
+
+	// consumer thread only, appends values in push order
+	void pop_all(std::vector<T>& values) {
+		if (m_head == NULL) {
+			return;
+		}
+
+		node_t* head = __sync_lock_test_and_set(&m_head, static_cast<node_t*>(NULL));
+		__sync_synchronize();
+
+		size_t first = values.size();
+		for (node_t* node = head; node != NULL; node = node->next) {
+			values.push_back(node->value);
+		}
+
+		std::reverse(values.begin() + first, values.end());
+		release(head);
+	}
+
+private:
+	struct node_t {
+		explicit node_t(const T& value_) :
+			value(value_),
+			next(NULL) {}
+
+		T		value;
+		node_t*	next;
+	};
+
+	static void release(node_t* node) {
+		while (node != NULL) {
+			node_t* next = node->next;
+			delete node;
+			node = next;
+		}
+	}
+
+private:
+	node_t* volatile m_head;
+};
+
+} // namespace dealer
+} // namespace cocaine
+
+#endif // _COCAINE_DEALER_MPSC_QUEUE_HPP_INCLUDED_
@@ -22,6 +22,7 @@
 #define _COCAINE_DEALER_PROGRESS_TIMER_HPP_INCLUDED_
 
 #include <cocaine/dealer/utils/time_value.hpp>
+#include <cocaine/dealer/utils/monotonic_clock.hpp>
 
 namespace cocaine {
 namespace dealer {
@@ -37,10 +38,13 @@ public:
 
     time_value started_at() const;
 	void reset();
+
+	// measured by monotonic clock, wall clock jumps do not affect it
 	time_value elapsed();
 
 private:
 	time_value begin_;
+	nanoseconds_t begin_ns_;
 };
 
 } // namespace dealer
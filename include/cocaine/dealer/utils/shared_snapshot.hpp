@@ -0,0 +1,126 @@
+/*
+    Copyright (c) 2011-2012 Rim Zaidullin <creator@bash.org.ru>
+    Copyright (c) 2011-2012 Other contributors as noted in the AUTHORS file.
+
+    This file is part of Cocaine.
+
+    Cocaine is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Cocaine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>. 
+*/
+
+#ifndef _COCAINE_DEALER_SHARED_SNAPSHOT_HPP_INCLUDED_
+#define _COCAINE_DEALER_SHARED_SNAPSHOT_HPP_INCLUDED_
+
+#include <boost/shared_ptr.hpp>
+#include <boost/weak_ptr.hpp>
+#include <boost/utility.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/tss.hpp>
+
+namespace cocaine {
+namespace dealer {
+
+// generations are unique across all snapshots, so a thread cache left by a
+// destroyed snapshot never matches the one reusing its address
+inline unsigned long
+next_snapshot_generation() {
+	static volatile unsigned long generation = 0;
+	return __sync_add_and_fetch(&generation, 1);
+}
+
+// immutable object published to readers, writers build a new copy and
+// store it, readers keep the snapshot they loaded for as long as needed;
+// every thread remembers the last snapshot it loaded along with its
+// generation, so until the next store a load is a generation check and
+// the mutex is taken only by the first load after a publish
+template<typename T>
+class shared_snapshot_t : private boost::noncopyable {
+public:
+	typedef boost::shared_ptr<const T> snapshot_ptr_t;
+
+public:
+	explicit shared_snapshot_t(const snapshot_ptr_t& value = snapshot_ptr_t()) :
+		m_value(value),
+		m_generation(next_snapshot_generation()) {}
+
+	snapshot_ptr_t load() const {
+		thread_cache_t* cache = m_thread_cache.get();
+
+		if (cache && cache->generation == m_generation) {
+			if (cache->is_empty) {
+				return snapshot_ptr_t();
+			}
+
+			// weak reference, so cache never keeps a replaced snapshot alive
+			snapshot_ptr_t value = cache->value.lock();
+
+			if (value) {
+				return value;
+			}
+		}
+
+		return reload(cache);
+	}
+
+	void store(const snapshot_ptr_t& value) {
+		snapshot_ptr_t old_value = value;
+
+		{
+			boost::mutex::scoped_lock lock(m_mutex);
+			m_value.swap(old_value);
+
+			// value must be in place before readers see new generation
+			__sync_synchronize();
+			m_generation = next_snapshot_generation();
+		}
+
+		// previous snapshot is released out of lock
+	}
+
+private:
+	struct thread_cache_t {
+		thread_cache_t() :
+			generation(0),
+			is_empty(true) {}
+
+		unsigned long generation;
+		bool is_empty;
+		boost::weak_ptr<const T> value;
+	};
+
+	snapshot_ptr_t reload(thread_cache_t* cache) const {
+		if (!cache) {
+			cache = new thread_cache_t();
+			m_thread_cache.reset(cache);
+		}
+
+		boost::mutex::scoped_lock lock(m_mutex);
+
+		cache->generation = m_generation;
+		cache->is_empty = !m_value;
+		cache->value = m_value;
+
+		return m_value;
+	}
+
+private:
+	snapshot_ptr_t m_value;
+	volatile unsigned long m_generation;
+	mutable boost::mutex m_mutex;
+	mutable boost::thread_specific_ptr<thread_cache_t> m_thread_cache;
+};
+
+} // namespace dealer
+} // namespace cocaine
+
+#endif // _COCAINE_DEALER_SHARED_SNAPSHOT_HPP_INCLUDED_
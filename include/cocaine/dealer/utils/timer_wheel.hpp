@@ -0,0 +1,296 @@
+/*
+    Copyright (c) 2011-2012 Rim Zaidullin <creator@bash.org.ru>
+    Copyright (c) 2011-2012 Other contributors as noted in the AUTHORS file.
+
+    This file is part of Cocaine.
+
+    Cocaine is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Cocaine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>. 
+*/
+
+#ifndef _COCAINE_DEALER_TIMER_WHEEL_HPP_INCLUDED_
+#define _COCAINE_DEALER_TIMER_WHEEL_HPP_INCLUDED_
+
+#include <vector>
+#include <algorithm>
+
+#include <boost/utility.hpp>
+#include <boost/cstdint.hpp>
+
+#include "cocaine/dealer/utils/monotonic_clock.hpp"
+
+namespace cocaine {
+namespace dealer {
+
+// armed timer handle, generation in high bits, slot + 1 in low bits
+typedef boost::uint64_t timer_id_t;
+
+static const timer_id_t invalid_timer_id = 0;
+
+// hierarchical timer wheel with millisecond ticks: level 0 holds timers
+// due within 256 ms, each upper level 64 times longer spans, timers are
+// cascaded down as the wheel turns, so arm, cancel and expiry are O(1)
+template<typename T>
+class timer_wheel_t : private boost::noncopyable {
+public:
+	explicit timer_wheel_t(nanoseconds_t now = monotonic_clock_t::now()) :
+		m_now(to_ticks(now)),
+		m_size(0),
+		m_free(npos)
+	{
+		m_lists.resize(lists_count, npos);
+	}
+
+	size_t size() const {
+		return m_size;
+	}
+
+	timer_id_t arm(nanoseconds_t expires, const T& value) {
+		size_t index = m_free;
+
+		if (index == npos) {
+			index = m_nodes.size();
+			m_nodes.push_back(node_t());
+		}
+		else {
+			m_free = m_nodes[index].next;
+		}
+
+		node_t& node = m_nodes[index];
+		node.expires = (expires + monotonic_clock_t::nanoseconds_per_millisecond - 1) / monotonic_clock_t::nanoseconds_per_millisecond;
+		node.armed = true;
+		node.value = value;
+
+		place(index);
+		++m_size;
+
+		return (static_cast<timer_id_t>(node.generation) << 32) | (index + 1);
+	}
+
+	// false if timer already fired or was cancelled
+	bool cancel(timer_id_t id) {
+		if (id == invalid_timer_id) {
+			return false;
+		}
+
+		size_t index = static_cast<size_t>(id & 0xffffffffULL) - 1;
+
+		if (index >= m_nodes.size()) {
+			return false;
+		}
+
+		node_t& node = m_nodes[index];
+
+		if (!node.armed || node.generation != static_cast<boost::uint32_t>(id >> 32)) {
+			return false;
+		}
+
+		unlink(index);
+		release(index);
+
+		return true;
+	}
+
+	// collect values of timers due at or before now
+	void advance(nanoseconds_t now, std::vector<T>& expired) {
+		boost::uint64_t now_ticks = to_ticks(now);
+
+		if (m_size == 0) {
+			m_now = std::max(m_now, now_ticks + 1);
+			return;
+		}
+
+		for (; m_now <= now_ticks; ++m_now) {
+			// cascade upper levels when lower one wraps
+			for (size_t level = 1; level < levels_count; ++level) {
+				if ((m_now & ((1ULL << level_shift(level)) - 1)) != 0) {
+					break;
+				}
+
+				cascade(list_index(level, m_now));
+			}
+
+			size_t list = list_index(0, m_now);
+
+			while (m_lists[list] != npos) {
+				size_t index = m_lists[list];
+				expired.push_back(m_nodes[index].value);
+
+				unlink(index);
+				release(index);
+			}
+
+			if (m_size == 0) {
+				m_now = now_ticks + 1;
+				break;
+			}
+		}
+	}
+
+	// milliseconds until the wheel must be advanced, -1 if nothing armed
+	long next_timeout(nanoseconds_t now) const {
+		if (m_size == 0) {
+			return -1;
+		}
+
+		boost::uint64_t now_ticks = to_ticks(now);
+		boost::uint64_t tick = m_now;
+
+		// look through level 0 up to next cascade
+		while ((tick & (level0_size - 1)) != 0 && m_lists[list_index(0, tick)] == npos) {
+			++tick;
+		}
+
+		if (tick <= now_ticks) {
+			return 0;
+		}
+
+		return static_cast<long>(tick - now_ticks);
+	}
+
+private:
+	static const size_t npos = static_cast<size_t>(-1);
+
+	static const size_t levels_count = 4;
+	static const size_t level0_bits = 8;
+	static const size_t level_bits = 6;
+	static const size_t level0_size = 1 << level0_bits;
+	static const size_t level_size = 1 << level_bits;
+	static const size_t lists_count = level0_size + (levels_count - 1) * level_size;
+
+	struct node_t {
+		node_t() :
+			expires(0),
+			generation(0),
+			armed(false),
+			list(npos),
+			prev(npos),
+			next(npos) {}
+
+		boost::uint64_t	expires;
+		boost::uint32_t	generation;
+		bool			armed;
+
+		size_t list;
+		size_t prev;
+		size_t next;
+
+		T value;
+	};
+
+	static boost::uint64_t to_ticks(nanoseconds_t time) {
+		return time / monotonic_clock_t::nanoseconds_per_millisecond;
+	}
+
+	static size_t level_shift(size_t level) {
+		return (level == 0) ? 0 : level0_bits + (level - 1) * level_bits;
+	}
+
+	static size_t list_index(size_t level, boost::uint64_t tick) {
+		if (level == 0) {
+			return static_cast<size_t>(tick & (level0_size - 1));
+		}
+
+		size_t slot = static_cast<size_t>((tick >> level_shift(level)) & (level_size - 1));
+		return level0_size + (level - 1) * level_size + slot;
+	}
+
+	void place(size_t index) {
+		node_t& node = m_nodes[index];
+
+		boost::uint64_t expires = std::max(node.expires, m_now);
+		boost::uint64_t delta = expires - m_now;
+
+		size_t level = 0;
+		while (level + 1 < levels_count && delta >= (1ULL << level_shift(level + 1))) {
+			++level;
+		}
+
+		// too far in future, park in the last slot and re-place on cascade
+		if (delta >= (1ULL << (level_shift(levels_count - 1) + level_bits))) {
+			expires = m_now + (1ULL << (level_shift(levels_count - 1) + level_bits)) - 1;
+		}
+
+		size_t list = list_index(level, expires);
+
+		node.list = list;
+		node.prev = npos;
+		node.next = m_lists[list];
+
+		if (node.next != npos) {
+			m_nodes[node.next].prev = index;
+		}
+
+		m_lists[list] = index;
+	}
+
+	void unlink(size_t index) {
+		node_t& node = m_nodes[index];
+
+		if (node.prev != npos) {
+			m_nodes[node.prev].next = node.next;
+		}
+		else {
+			m_lists[node.list] = node.next;
+		}
+
+		if (node.next != npos) {
+			m_nodes[node.next].prev = node.prev;
+		}
+
+		node.list = npos;
+		node.prev = npos;
+		node.next = npos;
+	}
+
+	void release(size_t index) {
+		node_t& node = m_nodes[index];
+
+		node.armed = false;
+		node.value = T();
+		++node.generation;
+
+		node.next = m_free;
+		m_free = index;
+
+		--m_size;
+	}
+
+	void cascade(size_t list) {
+		size_t index = m_lists[list];
+		m_lists[list] = npos;
+
+		while (index != npos) {
+			size_t next = m_nodes[index].next;
+			place(index);
+			index = next;
+		}
+	}
+
+private:
+	std::vector<node_t>	m_nodes;
+	std::vector<size_t>	m_lists;
+
+	// next tick to be processed
+	boost::uint64_t	m_now;
+	size_t			m_size;
+	size_t			m_free;
+};
+
+template<typename T> const size_t timer_wheel_t<T>::npos;
+template<typename T> const size_t timer_wheel_t<T>::lists_count;
+
+} // namespace dealer
+} // namespace cocaine
+
+#endif // _COCAINE_DEALER_TIMER_WHEEL_HPP_INCLUDED_
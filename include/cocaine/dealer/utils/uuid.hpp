@@ -22,80 +22,106 @@
 #define _COCAINE_DEALER_UUID_HPP_INCLUDED_
 
 #include <cstring>
+#include <string>
+#include <algorithm>
 #include <uuid/uuid.h>
 
+#include <boost/cstdint.hpp>
+
+#include <cocaine/dealer/utils/id_generator.hpp>
+
 namespace cocaine {
 namespace dealer {
 
+// 16 byte message id, trivially copyable, strings are built
+// only on request (wire, storage keys and logging)
 class wuuid_t {
 public:
     static const int UUID_SIZE = 16;
 
-    wuuid_t(const wuuid_t& rhs) {
-        memcpy(m_uuid, rhs.m_uuid, UUID_SIZE);
-        m_str_human_readable_value = rhs.m_str_human_readable_value;
-        m_str_value = rhs.m_str_value;
+    wuuid_t() {
+        memset(m_uuid, 0, UUID_SIZE);
     }
 
     wuuid_t(const std::string& uuid) {
-        memcpy(m_uuid, uuid.data(), UUID_SIZE);
+        memset(m_uuid, 0, UUID_SIZE);
+        memcpy(m_uuid, uuid.data(), std::min<size_t>(uuid.size(), UUID_SIZE));
     }
 
-    wuuid_t(uuid_t uuid) {
+    wuuid_t(const uuid_t uuid) {
         memcpy(m_uuid, uuid, UUID_SIZE);
     }
 
-	wuuid_t() {
-        memset(m_uuid, 0, sizeof(m_uuid));
-    }
-
     void generate() {
-        uuid_generate(m_uuid);
-        m_str_value.clear();
-        m_str_human_readable_value.clear();
+        id_generator_t::generate(m_uuid);
     }
 
-	const std::string& as_string() {
-        if (m_str_value.empty()) {
-    		m_str_value = std::string(reinterpret_cast<char*>(m_uuid), UUID_SIZE);
-        }
-
-		return m_str_value;
-	}
+    // raw 16 bytes
+    std::string as_string() const {
+        return std::string(reinterpret_cast<const char*>(m_uuid), UUID_SIZE);
+    }
 
-    const std::string& as_human_readable_string() {
-        if (m_str_human_readable_value.empty()) {
-            char buff[37];
-            uuid_unparse(m_uuid, buff);
-            m_str_human_readable_value = buff;
-        }
+    // for logging only
+    std::string as_human_readable_string() const {
+        char buff[37];
+        uuid_unparse(m_uuid, buff);
+        return std::string(buff);
+    }
 
-        return m_str_human_readable_value;
+    // raw 16 bytes of uuid
+    const unsigned char* data() const {
+        return m_uuid;
     }
 
-    bool is_empty() {
-        static uuid_t empty_uuid = {0};
-        if (0 == memcmp(m_uuid, empty_uuid, UUID_SIZE)) {
-            return true;
-        }
+    bool is_empty() const {
+        static const uuid_t empty_uuid = {0};
+        return (0 == memcmp(m_uuid, empty_uuid, UUID_SIZE));
+    }
 
-        return false;
+    // murmur3 finalizer over both halves, ids need not be random
+    size_t hash() const {
+        boost::uint64_t lo;
+        boost::uint64_t hi;
+        memcpy(&lo, m_uuid, sizeof(lo));
+        memcpy(&hi, m_uuid + sizeof(lo), sizeof(hi));
+
+        boost::uint64_t h = lo ^ (hi * 0x9e3779b97f4a7c15ULL);
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ULL;
+        h ^= h >> 33;
+
+        return static_cast<size_t>(h);
     }
 
     bool operator == (const wuuid_t& rhs) const {
-        if (0 == memcmp(m_uuid, rhs.m_uuid, UUID_SIZE)) {
-            return true;
-        }
+        return (0 == memcmp(m_uuid, rhs.m_uuid, UUID_SIZE));
+    }
+
+    bool operator != (const wuuid_t& rhs) const {
+        return !(*this == rhs);
+    }
 
-        return false;
+    bool operator < (const wuuid_t& rhs) const {
+        return (memcmp(m_uuid, rhs.m_uuid, UUID_SIZE) < 0);
     }
 
 private:
-    uuid_t      m_uuid;
-    std::string m_str_human_readable_value;
-    std::string m_str_value;
+    uuid_t m_uuid;
 };
 
+struct wuuid_hash_t {
+    size_t operator () (const wuuid_t& uuid) const {
+        return uuid.hash();
+    }
+};
+
+// for boost::hash
+inline size_t hash_value(const wuuid_t& uuid) {
+    return uuid.hash();
+}
+
 } // namespace dealer
 } // namespace cocaine
 
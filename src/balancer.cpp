@@ -18,25 +18,50 @@
 	along with this program. If not, see <http://www.gnu.org/licenses/>. 
 */
 
+#include <cstdlib>
+#include <ctime>
+
 #include <msgpack.hpp>
 
 #include <boost/thread.hpp>
+#include <boost/make_shared.hpp>
 
 #include "cocaine/dealer/utils/error.hpp"
 #include "cocaine/dealer/utils/networking.hpp"
+#include "cocaine/dealer/utils/buffer_pool.hpp"
 #include "cocaine/dealer/core/balancer.hpp"
 
 namespace cocaine {
 namespace dealer {
 
+namespace {
+	// called by zmq once payload frame is sent or dropped
+	void release_payload(void* data, void* hint) {
+		delete static_cast<data_container*>(hint);
+	}
+
+	void release_pooled_payload(void* data, void* hint) {
+		data_container::release_buffer(data);
+	}
+}
+
+const double balancer_t::latency_ewma_factor = 0.2;
+const double balancer_t::latency_floor = 0.001; // seconds
+
 balancer_t::balancer_t(const std::string& identity,
 					   const std::set<cocaine_endpoint_t>& endpoints,
 					   const boost::shared_ptr<context_t>& ctx,
+					   const boost::shared_ptr<message_cache_t>& message_cache,
+					   enum e_balancing_type balancing_type,
 					   bool logging_enabled) :
 	dealer_object_t(ctx, logging_enabled),
 	m_endpoints(endpoints),
+	m_total_weight(0),
 	m_current_endpoint_index(0),
-	m_socket_identity(identity)
+	m_socket_identity(identity),
+	m_message_cache(message_cache),
+	m_balancing_type(balancing_type),
+	m_random_seed(static_cast<unsigned int>(time(NULL)) ^ static_cast<unsigned int>(reinterpret_cast<size_t>(this)))
 {
 	create_socket();
 
@@ -45,6 +70,8 @@ balancer_t::balancer_t(const std::string& identity,
 		m_endpoints_vec.push_back(*it);
 	}
 
+	update_available_endpoints();
+
 	if (m_endpoints.empty()) {
 		return;
 	}
@@ -122,6 +149,12 @@ balancer_t::update_endpoints(const std::set<cocaine_endpoint_t>& endpoints,
 		}
 	}
 
+	// remember round robin state of endpoints that may survive the update
+	current_weights_map_t carried_weights;
+	for (size_t i = 0; i < m_available_endpoints.size(); ++i) {
+		carried_weights[m_endpoints_vec[m_available_endpoints[i]]] = m_current_weights[i];
+	}
+
 	// replace current endpoints data
 	m_endpoints.clear();
 	m_endpoints.insert(endpoints.begin(), endpoints.end());
@@ -135,6 +168,45 @@ balancer_t::update_endpoints(const std::set<cocaine_endpoint_t>& endpoints,
 	connect_socket(new_endpoints);
 
 	m_current_endpoint_index = 0;
+	update_available_endpoints(carried_weights);
+
+	// forget stats of routes that are gone
+	route_stats_map_t::iterator stats_it = m_route_stats.begin();
+	while (stats_it != m_route_stats.end()) {
+		bool route_exists = false;
+		for (size_t i = 0; i < m_endpoints_vec.size(); ++i) {
+			if (m_endpoints_vec[i].route == stats_it->first) {
+				route_exists = true;
+				break;
+			}
+		}
+
+		if (route_exists) {
+			++stats_it;
+		}
+		else {
+			m_route_stats.erase(stats_it++);
+		}
+	}
+}
+
+void
+balancer_t::update_available_endpoints(const current_weights_map_t& carried_weights) {
+	m_available_endpoints.clear();
+	m_current_weights.clear();
+	m_total_weight = 0;
+
+	for (size_t i = 0; i < m_endpoints_vec.size(); ++i) {
+		if (m_endpoints_vec[i].weight > 0) {
+			// surviving endpoints keep their credit so the schedule converges
+			current_weights_map_t::const_iterator it = carried_weights.find(m_endpoints_vec[i]);
+			long long current_weight = (it != carried_weights.end()) ? it->second : 0;
+
+			m_available_endpoints.push_back(i);
+			m_current_weights.push_back(current_weight);
+			m_total_weight += m_endpoints_vec[i].weight;
+		}
+	}
 }
 
 void
@@ -165,62 +237,127 @@ balancer_t::create_socket() {
 	}
 }
 
-cocaine_endpoint_t&
+const cocaine_endpoint_t*
 balancer_t::get_next_endpoint() {
-	// increment iter
-	if (m_current_endpoint_index < m_endpoints_vec.size() - 1) {
-		++m_current_endpoint_index;
-	}
-	else {
-		m_current_endpoint_index = 0;
+	if (m_available_endpoints.empty()) {
+		return NULL;
 	}
 
-	// make sure endpoint is avail
-	if (m_endpoints_vec[m_current_endpoint_index].weight > 0) {
-		return m_endpoints_vec[m_current_endpoint_index];
+	switch (m_balancing_type) {
+		case BT_LEAST_OUTSTANDING:
+			return next_least_outstanding_endpoint();
+
+		case BT_ROUND_ROBIN:
+		default:
+			return next_round_robin_endpoint();
 	}
+}
 
-	// if not — find the one that is
-	bool found = false;
-	for (size_t i = m_current_endpoint_index; i < m_endpoints_vec.size(); ++i) {
-		if (m_endpoints_vec[i].weight > 0) {
-			m_current_endpoint_index = i;
-			found = true;
-			break;
+const cocaine_endpoint_t*
+balancer_t::next_round_robin_endpoint() {
+	// smooth weighted round robin: every endpoint earns its weight on each pick,
+	// the richest one is chosen and pays total weight back, which interleaves
+	// endpoints in proportion to their weights
+	size_t best = 0;
+
+	for (size_t i = 0; i < m_available_endpoints.size(); ++i) {
+		m_current_weights[i] += m_endpoints_vec[m_available_endpoints[i]].weight;
+
+		if (m_current_weights[i] > m_current_weights[best]) {
+			best = i;
 		}
 	}
 
-	if (!found) {
-		for (size_t i = 0; i < m_current_endpoint_index; ++i) {
-			if (m_endpoints_vec[i].weight > 0) {
-				m_current_endpoint_index = i;
-				found = true;
-				break;
-			}
-		}
+	m_current_weights[best] -= m_total_weight;
+	m_current_endpoint_index = best;
+
+	return &m_endpoints_vec[m_available_endpoints[best]];
+}
+
+const cocaine_endpoint_t*
+balancer_t::next_least_outstanding_endpoint() {
+	size_t count = m_available_endpoints.size();
+
+	if (count == 1) {
+		return &m_endpoints_vec[m_available_endpoints[0]];
 	}
 
-	assert(found);
-	
-	return m_endpoints_vec[m_current_endpoint_index];
+	// power of two choices: pick two distinct endpoints at random, take the cheaper one
+	size_t first = rand_r(&m_random_seed) % count;
+	size_t second = rand_r(&m_random_seed) % (count - 1);
+
+	if (second >= first) {
+		++second;
+	}
+
+	const cocaine_endpoint_t& first_endpoint = m_endpoints_vec[m_available_endpoints[first]];
+	const cocaine_endpoint_t& second_endpoint = m_endpoints_vec[m_available_endpoints[second]];
+
+	if (endpoint_cost(first_endpoint) <= endpoint_cost(second_endpoint)) {
+		return &first_endpoint;
+	}
+
+	return &second_endpoint;
+}
+
+double
+balancer_t::endpoint_cost(const cocaine_endpoint_t& endpoint) {
+	double latency = latency_floor;
+
+	route_stats_map_t::const_iterator it = m_route_stats.find(endpoint.route);
+	if (it != m_route_stats.end()) {
+		latency += it->second.ack_latency + it->second.response_latency;
+	}
+
+	// expected wait for a new message: requests in flight times observed latency,
+	// divided by announced capacity of endpoint
+	size_t in_flight = m_message_cache->sent_messages_count(endpoint.route);
+	return (in_flight + 1) * latency / endpoint.weight;
+}
+
+void
+balancer_t::register_ack(const std::string& route, double latency) {
+	route_stats_t& stats = m_route_stats[route];
+
+	if (stats.ack_latency == 0.0) {
+		stats.ack_latency = latency;
+	}
+	else {
+		stats.ack_latency += latency_ewma_factor * (latency - stats.ack_latency);
+	}
+}
+
+void
+balancer_t::register_response(const std::string& route, double latency) {
+	route_stats_t& stats = m_route_stats[route];
+
+	if (stats.response_latency == 0.0) {
+		stats.response_latency = latency;
+	}
+	else {
+		stats.response_latency += latency_ewma_factor * (latency - stats.response_latency);
+	}
 }
 
 bool
-balancer_t::send(boost::shared_ptr<message_iface>& message, cocaine_endpoint_t& endpoint) {
+balancer_t::send(dispatch_message_ptr_t& message, const cocaine_endpoint_t*& endpoint) {
 	assert(m_socket);
 
 	try {
-		// send ident
+		// route, uuid and policy frames are pre-encoded, just copy them into
+		// frames (zmq keeps small frames inline without heap allocation)
 		endpoint = get_next_endpoint();
-		message->set_destination_endpoint(endpoint.endpoint);
 
-		std::string new_route = endpoint.route;
+		if (!endpoint) {
+			return false;
+		}
 
-		msgpack::sbuffer sbuf;
-        msgpack::pack(sbuf, new_route);
+		message->set_destination_endpoint(endpoint->endpoint_id);
 
-		zmq::message_t ident_chunk(sbuf.size());
-		memcpy((void *)ident_chunk.data(), sbuf.data(), sbuf.size());
+		// send ident
+		const std::string& route = endpoint->packed_route;
+		zmq::message_t ident_chunk(route.size());
+		memcpy((void *)ident_chunk.data(), route.data(), route.size());
 
 		if (true != m_socket->send(ident_chunk, ZMQ_SNDMORE)) {
 			return false;
@@ -233,41 +370,46 @@ balancer_t::send(boost::shared_ptr<message_iface>& message, cocaine_endpoint_t&
 		}
 
 		// send message uuid
-		const std::string& uuid = message->uuid().as_string();
+		const wuuid_t& uuid = message->uuid();
 
-		zmq::message_t uuid_chunk(uuid.size());
-		memcpy((void *)uuid_chunk.data(), uuid.data(), uuid.size());
+		zmq::message_t uuid_chunk(wuuid_t::UUID_SIZE);
+		memcpy((void *)uuid_chunk.data(), uuid.data(), wuuid_t::UUID_SIZE);
 
 		if (true != m_socket->send(uuid_chunk, ZMQ_SNDMORE)) {
 			return false;
 		}
 
 		// send message policy
-		policy_t server_policy = message->policy().server_policy();
+		const std::string& policy = message->packed_server_policy();
 
-		if (server_policy.deadline > 0.0) {
-			// awful semantics! convert deadline [timeout value] to actual [deadline time]
-			time_value server_deadline = message->enqued_timestamp();
-			server_deadline += server_policy.deadline;
-			server_policy.deadline = server_deadline.as_double();
-		}
-
-		sbuf.clear();
-		msgpack::pack(sbuf, server_policy);
-		zmq::message_t policy_chunk(sbuf.size());
-		memcpy((void *)policy_chunk.data(), sbuf.data(), sbuf.size());
+		zmq::message_t policy_chunk(policy.size());
+		memcpy((void *)policy_chunk.data(), policy.data(), policy.size());
 
 		if (true != m_socket->send(policy_chunk, ZMQ_SNDMORE)) {
 			return false;
 		}
 
-		// send data
-		size_t data_size = message->size();
-		zmq::message_t data_chunk(data_size);
+		// send data, frame holds a reference to message buffer instead of a copy
+		zmq::message_t data_chunk;
 
-		if (data_size > 0) {
+		if (message->size() > 0) {
 			message->load_data();
-			memcpy((void *)data_chunk.data(), message->data(), data_size);
+			const data_container& buffer = message->buffer();
+
+			// pooled buffer carries its own refcount, no holder needed
+			if (buffer.retain_buffer()) {
+				data_chunk.rebuild(buffer.data(), buffer.size(), &release_pooled_payload, NULL);
+			}
+			else if (buffer.is_inline()) {
+				data_chunk.rebuild(buffer.size());
+				memcpy(data_chunk.data(), buffer.data(), buffer.size());
+			}
+			else {
+				std::auto_ptr<data_container> payload(new data_container(buffer));
+				data_chunk.rebuild(payload->data(), payload->size(), &release_payload, payload.get());
+				payload.release();
+			}
+
 			message->unload_data();
 		}
 
@@ -314,6 +456,12 @@ balancer_t::check_for_responses(int poll_timeout) const {
 	return false;
 }
 
+zmq::socket_t&
+balancer_t::socket() {
+	assert(m_socket);
+	return *m_socket;
+}
+
 bool
 balancer_t::is_valid_rpc_code(int rpc_code) {
 	switch (rpc_code) {
@@ -338,13 +486,6 @@ namespace {
 		MSGPACK_DEFINE(code, data)
 	};
 
-	struct unpacked_chunk {
-		std::string uuid;
-		std::string data;
-
-		MSGPACK_DEFINE(uuid, data)
-	};
-
 	struct unpacked_error {
 		std::string uuid;
 		int			code;
@@ -392,8 +533,12 @@ balancer_t::receive(boost::shared_ptr<response_chunk_t>& response) {
 		return false;
 	}
 
-	// receive response
-	if (!nutils::recv_zmq_message(*m_socket, chunk, unpacked)) {
+	// receive response, frame is kept alive by chunk data referencing it,
+	// frame and its refcount share one pooled block
+	boost::shared_ptr<zmq::message_t> response_frame =
+		boost::allocate_shared<zmq::message_t>(buffer_pool_allocator_t<zmq::message_t>());
+
+	if (!nutils::recv_zmq_message(*m_socket, *response_frame, unpacked)) {
 		return false;
 	}
 
@@ -415,11 +560,23 @@ balancer_t::receive(boost::shared_ptr<response_chunk_t>& response) {
 	// receive all data
 	switch (rpc_code) {
 		case SERVER_RPC_MESSAGE_CHUNK: {
-			unpacked_chunk chunk_resp;
-			unpacked.get().via.array.ptr[1].convert(&chunk_resp);
+			// [uuid, data], unpacked raw data points right into response frame
+			const msgpack::object& chunk_resp = unpacked.get().via.array.ptr[1];
+
+			if (chunk_resp.type != msgpack::type::ARRAY ||
+				chunk_resp.via.array.size != 2 ||
+				chunk_resp.via.array.ptr[1].type != msgpack::type::RAW)
+			{
+				throw msgpack::type_error();
+			}
+
+			std::string uuid;
+			chunk_resp.via.array.ptr[0].convert(&uuid);
+
+			const msgpack::object_raw& data = chunk_resp.via.array.ptr[1].via.raw;
 
-			response->uuid = chunk_resp.uuid;
-			response->data = data_container(chunk_resp.data.data(), chunk_resp.data.size());
+			response->uuid = uuid;
+			response->data = data_container(data.ptr, data.size, response_frame);
 		}
 		break;
 
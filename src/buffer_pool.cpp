@@ -0,0 +1,241 @@
+/*
+    Copyright (c) 2011-2012 Rim Zaidullin <creator@bash.org.ru>
+    Copyright (c) 2011-2012 Other contributors as noted in the AUTHORS file.
+
+    This file is part of Cocaine.
+
+    Cocaine is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Cocaine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>. 
+*/
+
+#include <cstdlib>
+#include <string>
+
+#include <boost/static_assert.hpp>
+#include <boost/current_function.hpp>
+
+#include "cocaine/dealer/utils/buffer_pool.hpp"
+#include "cocaine/dealer/utils/error.hpp"
+
+namespace cocaine {
+namespace dealer {
+
+const size_t buffer_pool_t::header_size;
+const size_t buffer_pool_t::min_block_size;
+const unsigned int buffer_pool_t::size_classes_count;
+const unsigned int buffer_pool_t::unpooled_class;
+const size_t buffer_pool_t::thread_cache_bytes;
+const size_t buffer_pool_t::thread_cache_min_blocks;
+const size_t buffer_pool_t::shared_cache_bytes;
+const size_t buffer_pool_t::shared_cache_min_blocks;
+
+buffer_pool_t::buffer_pool_t() {
+	BOOST_STATIC_ASSERT(sizeof(block_t) <= header_size);
+}
+
+buffer_pool_t&
+buffer_pool_t::instance() {
+	// never destroyed, buffers may be released by static destructors
+	static buffer_pool_t* pool = new buffer_pool_t();
+	return *pool;
+}
+
+buffer_pool_t::thread_cache_t::~thread_cache_t() {
+	buffer_pool_t& pool = buffer_pool_t::instance();
+
+	for (unsigned int i = 0; i < size_classes_count; ++i) {
+		pool.spill(lists[i], i, lists[i].count);
+	}
+}
+
+unsigned char*
+buffer_pool_t::allocate(size_t size) {
+	unsigned int size_class = size_class_for(size);
+	block_t* block = NULL;
+
+	if (size_class == unpooled_class) {
+		block = static_cast<block_t*>(malloc(header_size + size));
+	}
+	else {
+		block = instance().take(size_class);
+	}
+
+	if (!block) {
+		std::string error_msg = "not enough memory to allocate buffer at ";
+		error_msg += std::string(BOOST_CURRENT_FUNCTION);
+		throw internal_error(error_msg);
+	}
+
+	block->refs = 1;
+	block->size_class = size_class;
+	block->next = NULL;
+
+	return data_of(block);
+}
+
+void
+buffer_pool_t::add_ref(unsigned char* data) {
+	__sync_add_and_fetch(&block_of(data)->refs, 1);
+}
+
+void
+buffer_pool_t::release(unsigned char* data) {
+	block_t* block = block_of(data);
+
+	if (__sync_sub_and_fetch(&block->refs, 1) != 0) {
+		return;
+	}
+
+	if (block->size_class == unpooled_class) {
+		free(block);
+		return;
+	}
+
+	instance().put(block);
+}
+
+unsigned int
+buffer_pool_t::size_class_for(size_t size) {
+	size_t needed = header_size + size;
+
+	unsigned int size_class = 0;
+	while (size_class < size_classes_count && block_size(size_class) < needed) {
+		++size_class;
+	}
+
+	return size_class;
+}
+
+size_t
+buffer_pool_t::block_size(unsigned int size_class) {
+	return min_block_size << size_class;
+}
+
+size_t
+buffer_pool_t::cached_blocks_limit(size_t cache_bytes, size_t min_blocks, unsigned int size_class) {
+	size_t blocks = cache_bytes / block_size(size_class);
+	return (blocks < min_blocks) ? min_blocks : blocks;
+}
+
+buffer_pool_t::block_t*
+buffer_pool_t::block_of(unsigned char* data) {
+	return reinterpret_cast<block_t*>(data - header_size);
+}
+
+unsigned char*
+buffer_pool_t::data_of(block_t* block) {
+	return reinterpret_cast<unsigned char*>(block) + header_size;
+}
+
+buffer_pool_t::thread_cache_t*
+buffer_pool_t::thread_cache() {
+	thread_cache_t* cache = m_thread_cache.get();
+
+	if (!cache) {
+		cache = new thread_cache_t();
+		m_thread_cache.reset(cache);
+	}
+
+	return cache;
+}
+
+buffer_pool_t::block_t*
+buffer_pool_t::take(unsigned int size_class) {
+	free_list_t& list = thread_cache()->lists[size_class];
+
+	if (!list.head) {
+		refill(list, size_class, cached_blocks_limit(thread_cache_bytes, thread_cache_min_blocks, size_class) / 2);
+	}
+
+	if (!list.head) {
+		return static_cast<block_t*>(malloc(block_size(size_class)));
+	}
+
+	block_t* block = list.head;
+	list.head = block->next;
+	--list.count;
+
+	return block;
+}
+
+void
+buffer_pool_t::put(block_t* block) {
+	unsigned int size_class = block->size_class;
+	free_list_t& list = thread_cache()->lists[size_class];
+
+	block->next = list.head;
+	list.head = block;
+	++list.count;
+
+	// keep half of the limit, so alternating take and put stays local
+	size_t limit = cached_blocks_limit(thread_cache_bytes, thread_cache_min_blocks, size_class);
+
+	if (list.count > limit) {
+		spill(list, size_class, list.count - limit / 2);
+	}
+}
+
+void
+buffer_pool_t::refill(free_list_t& list, unsigned int size_class, size_t count) {
+	shared_list_t& shared = m_shared[size_class];
+	boost::mutex::scoped_lock lock(shared.mutex);
+
+	while (count > 0 && shared.list.head) {
+		block_t* block = shared.list.head;
+		shared.list.head = block->next;
+		--shared.list.count;
+
+		block->next = list.head;
+		list.head = block;
+		++list.count;
+		--count;
+	}
+}
+
+void
+buffer_pool_t::spill(free_list_t& list, unsigned int size_class, size_t count) {
+	size_t limit = cached_blocks_limit(shared_cache_bytes, shared_cache_min_blocks, size_class);
+	block_t* excess = NULL;
+
+	{
+		shared_list_t& shared = m_shared[size_class];
+		boost::mutex::scoped_lock lock(shared.mutex);
+
+		while (count > 0 && list.head) {
+			block_t* block = list.head;
+			list.head = block->next;
+			--list.count;
+			--count;
+
+			// shared list is full -> give block back to the system
+			if (shared.list.count >= limit) {
+				block->next = excess;
+				excess = block;
+				continue;
+			}
+
+			block->next = shared.list.head;
+			shared.list.head = block;
+			++shared.list.count;
+		}
+	}
+
+	while (excess) {
+		block_t* block = excess;
+		excess = block->next;
+		free(block);
+	}
+}
+
+} // namespace dealer
+} // namespace cocaine
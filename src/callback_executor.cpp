@@ -0,0 +1,94 @@
+/*
+    Copyright (c) 2011-2012 Rim Zaidullin <creator@bash.org.ru>
+    Copyright (c) 2011-2012 Other contributors as noted in the AUTHORS file.
+
+    This file is part of Cocaine.
+
+    Cocaine is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Cocaine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>. 
+*/
+
+#include <boost/bind.hpp>
+
+#include "cocaine/dealer/core/callback_executor.hpp"
+
+namespace cocaine {
+namespace dealer {
+
+callback_executor_t::callback_executor_t(unsigned int threads_count) {
+	for (unsigned int i = 0; i < threads_count; ++i) {
+		boost::shared_ptr<worker_t> worker(new worker_t);
+		worker->thread = boost::thread(boost::bind(&callback_executor_t::run, worker.get()));
+		m_workers.push_back(worker);
+	}
+}
+
+callback_executor_t::~callback_executor_t() {
+	// workers finish posted tasks before exit
+	for (size_t i = 0; i < m_workers.size(); ++i) {
+		boost::mutex::scoped_lock lock(m_workers[i]->mutex);
+		m_workers[i]->is_running = false;
+		m_workers[i]->cond_var.notify_one();
+	}
+
+	for (size_t i = 0; i < m_workers.size(); ++i) {
+		m_workers[i]->thread.join();
+	}
+}
+
+void
+callback_executor_t::post(size_t key, const task_t& task) {
+	worker_t& worker = *m_workers[key % m_workers.size()];
+
+	boost::mutex::scoped_lock lock(worker.mutex);
+	worker.tasks.push_back(task);
+
+	if (worker.tasks.size() == 1) {
+		worker.cond_var.notify_one();
+	}
+}
+
+void
+callback_executor_t::run(worker_t* worker) {
+	std::deque<task_t> tasks;
+
+	while (true) {
+		{
+			boost::mutex::scoped_lock lock(worker->mutex);
+
+			while (worker->tasks.empty() && worker->is_running) {
+				worker->cond_var.wait(lock);
+			}
+
+			if (worker->tasks.empty()) {
+				return;
+			}
+
+			tasks.swap(worker->tasks);
+		}
+
+		for (size_t i = 0; i < tasks.size(); ++i) {
+			try {
+				tasks[i]();
+			}
+			catch (...) {
+				// user callback errors must not stop the worker
+			}
+		}
+
+		tasks.clear();
+	}
+}
+
+} // namespace dealer
+} // namespace cocaine
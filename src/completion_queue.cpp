@@ -0,0 +1,123 @@
+/*
+    Copyright (c) 2011-2012 Rim Zaidullin <creator@bash.org.ru>
+    Copyright (c) 2011-2012 Other contributors as noted in the AUTHORS file.
+
+    This file is part of Cocaine.
+
+    Cocaine is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Cocaine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>. 
+*/
+
+#include <cerrno>
+#include <cstring>
+
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+#include <boost/current_function.hpp>
+
+#include "cocaine/dealer/completion_queue.hpp"
+#include "cocaine/dealer/utils/error.hpp"
+
+namespace cocaine {
+namespace dealer {
+
+completion_queue_t::completion_queue_t() :
+	m_fd(-1),
+	m_signaled(0)
+{
+	m_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+	if (m_fd < 0) {
+		std::string error_str = "could not create completion queue eventfd at ";
+		error_str += std::string(BOOST_CURRENT_FUNCTION);
+		error_str += ", error: " + std::string(strerror(errno));
+		throw internal_error(error_str);
+	}
+}
+
+completion_queue_t::~completion_queue_t() {
+	close(m_fd);
+}
+
+int
+completion_queue_t::fd() const {
+	return m_fd;
+}
+
+size_t
+completion_queue_t::reap(std::vector<completion_event_t>& events) {
+	eventfd_t value = 0;
+	ssize_t res = 0;
+
+	do {
+		res = read(m_fd, &value, sizeof(value));
+	} while (res < 0 && errno == EINTR);
+
+	// reset flag before taking events, producers that push after
+	// this point will signal fd again
+	__sync_lock_release(&m_signaled);
+	__sync_synchronize();
+
+	size_t count = events.size();
+	m_events.pop_all(events);
+
+	return events.size() - count;
+}
+
+void
+completion_queue_t::push(const completion_event_t& event) {
+	m_events.push(event);
+
+	// only the first event after a reap touches the eventfd
+	if (!__sync_bool_compare_and_swap(&m_signaled, 0, 1)) {
+		return;
+	}
+
+	eventfd_t value = 1;
+	ssize_t res = 0;
+
+	do {
+		res = write(m_fd, &value, sizeof(value));
+	} while (res < 0 && errno == EINTR);
+}
+
+void
+completion_queue_t::push_chunk(boost::uint64_t tag, const data_container& chunk) {
+	completion_event_t event;
+	event.type = COMPLETION_EVENT_CHUNK;
+	event.tag = tag;
+	event.data = chunk;
+
+	push(event);
+}
+
+void
+completion_queue_t::push_complete(boost::uint64_t tag, int error_code, const std::string& error_message) {
+	completion_event_t event;
+	event.tag = tag;
+
+	if (error_code == 0) {
+		event.type = COMPLETION_EVENT_CHOKE;
+	}
+	else {
+		event.type = COMPLETION_EVENT_ERROR;
+		event.error_code = error_code;
+		event.error_message = error_message;
+	}
+
+	push(event);
+}
+
+} // namespace dealer
+} // namespace cocaine
@@ -45,7 +45,10 @@ configuration_t::configuration_t() :
 	m_statistics_enabled(false),
 	m_remote_statistics_enabled(false),
 	m_remote_statistics_port(defaults_t::statistics_port),
-	m_endpoint_timeout(defaults_t::endpoint_timeout)
+	m_endpoint_timeout(defaults_t::endpoint_timeout),
+	m_reactor_threads(defaults_t::reactor_threads),
+	m_callback_threads(defaults_t::callback_threads),
+	m_message_id_type(defaults_t::message_id_type)
 {
 	
 }
@@ -63,7 +66,10 @@ configuration_t::configuration_t(const std::string& path) :
 	m_statistics_enabled(false),
 	m_remote_statistics_enabled(false),
 	m_remote_statistics_port(defaults_t::statistics_port),
-	m_endpoint_timeout(defaults_t::endpoint_timeout)
+	m_endpoint_timeout(defaults_t::endpoint_timeout),
+	m_reactor_threads(defaults_t::reactor_threads),
+	m_callback_threads(defaults_t::callback_threads),
+	m_message_id_type(defaults_t::message_id_type)
 {
 	load(path);
 }
@@ -268,6 +274,20 @@ configuration_t::parse_services_settings(const Json::Value& config_value) {
 			throw internal_error(error_str);
 		}
 
+		std::string balancing_type_str = service_data.get("balancing", "ROUND_ROBIN").asString();
+
+		if (balancing_type_str == "ROUND_ROBIN") {
+			si.balancing_type = BT_ROUND_ROBIN;
+		}
+		else if (balancing_type_str == "LEAST_OUTSTANDING") {
+			si.balancing_type = BT_LEAST_OUTSTANDING;
+		}
+		else {
+			std::string error_str = "service " + service_name + " has malformed field \"balancing\", ";
+			error_str += "which can only take values ROUND_ROBIN, LEAST_OUTSTANDING.";
+			throw internal_error(error_str);
+		}
+
 		// default message policy
 		const Json::Value mpolicy = service_data["policy"];
 		if (mpolicy.isObject()) {
@@ -361,6 +381,23 @@ configuration_t::parse_basic_settings(const Json::Value& config_value) {
 	if (m_endpoint_timeout < 1.0) {
 		m_endpoint_timeout = 1.0;
 	}
+
+	m_reactor_threads = config_value.get("reactor_threads", defaults_t::reactor_threads).asUInt();
+	m_callback_threads = config_value.get("callback_threads", defaults_t::callback_threads).asUInt();
+
+	std::string message_ids_str = config_value.get("message_ids", "UUID").asString();
+
+	if (message_ids_str == "UUID") {
+		m_message_id_type = MIT_UUID;
+	}
+	else if (message_ids_str == "SEQUENTIAL") {
+		m_message_id_type = MIT_SEQUENTIAL;
+	}
+	else {
+		std::string error_str = "unknown message ids type: " + message_ids_str;
+		error_str += ", message_ids property can only take UUID or SEQUENTIAL as value.";
+		throw internal_error(error_str);
+	}
 }
 
 const std::string&
@@ -443,6 +480,21 @@ configuration_t::endpoint_timeout() const {
 	return m_endpoint_timeout;
 }
 
+unsigned int
+configuration_t::reactor_threads() const {
+	return m_reactor_threads;
+}
+
+unsigned int
+configuration_t::callback_threads() const {
+	return m_callback_threads;
+}
+
+enum e_message_id_type
+configuration_t::message_id_type() const {
+	return m_message_id_type;
+}
+
 const std::map<std::string, service_info_t>&
 configuration_t::services_list() const {
 	return m_services_list;
@@ -481,6 +533,9 @@ configuration_t::as_string() const {
 	// basic
 	out << "basic settings\n";
 	out << "\tconfig version: " << configuration_t::current_config_version << "\n";
+	out << "\treactor threads: " << c.m_reactor_threads << "\n";
+	out << "\tcallback threads: " << c.m_callback_threads << "\n";
+	out << "\tmessage ids: " << (c.m_message_id_type == MIT_SEQUENTIAL ? "SEQUENTIAL" : "UUID") << "\n";
 	
 	// logger
 	out << "\nlogger\n";
@@ -559,6 +614,15 @@ configuration_t::as_string() const {
 				out << "\tautodiscovery type: undefined" << "\n";
 				break;
 		}
+
+		switch (it->second.balancing_type) {
+			case BT_ROUND_ROBIN:
+				out << "\tbalancing type: round robin" << "\n";
+				break;
+			case BT_LEAST_OUTSTANDING:
+				out << "\tbalancing type: least outstanding" << "\n";
+				break;
+		}
 	}
 
  	/*
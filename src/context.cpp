@@ -18,8 +18,16 @@
     along with this program. If not, see <http://www.gnu.org/licenses/>. 
 */
 
+#include <algorithm>
+
+#include <boost/functional/hash.hpp>
+#include <boost/thread/thread.hpp>
+
 #include "cocaine/dealer/core/context.hpp"
+#include "cocaine/dealer/core/reactor.hpp"
+#include "cocaine/dealer/core/callback_executor.hpp"
 #include "cocaine/dealer/utils/error.hpp"
+#include "cocaine/dealer/utils/id_generator.hpp"
 #include "cocaine/dealer/storage/eblob_storage.hpp"
     
 namespace cocaine {
@@ -62,14 +70,33 @@ context_t::context_t(const std::string& config_path) {
 	logger()->log(PLOG_DEBUG, "loaded config: %s", config()->config_path().c_str());
 	//logger()->log(config()->as_string());
 	
+	id_generator_t::set_sequential(m_config->message_id_type() == MIT_SEQUENTIAL);
+
 	// create zmq context
 	m_zmq_context.reset(new zmq::context_t(1));
 
+	// create reactors, handles are spread among them
+	unsigned int reactors_count = m_config->reactor_threads();
+	if (reactors_count == 0) {
+		reactors_count = std::max(1u, boost::thread::hardware_concurrency());
+	}
+
+	for (unsigned int i = 0; i < reactors_count; ++i) {
+		m_reactors.push_back(boost::shared_ptr<reactor_t>(new reactor_t()));
+	}
+
+	// without callback threads response callbacks run on reactors
+	if (m_config->callback_threads() > 0) {
+		m_callback_executor.reset(new callback_executor_t(m_config->callback_threads()));
+	}
+
 	// create statistics collector
 	//m_stats.reset(new statistics_collector(m_config, m_zmq_context, logger()));
 }
 
 context_t::~context_t() {
+	m_reactors.clear();
+	m_callback_executor.reset();
 	m_zmq_context.reset();
 	m_storage.reset();
 }
@@ -135,5 +162,16 @@ context_t::storage() {
 	return m_storage;
 }
 
+boost::shared_ptr<callback_executor_t>
+context_t::callback_executor() {
+	return m_callback_executor;
+}
+
+boost::shared_ptr<reactor_t>
+context_t::reactor_for(const std::string& handle_description) {
+	size_t index = boost::hash<std::string>()(handle_description) % m_reactors.size();
+	return m_reactors[index];
+}
+
 } // namespace dealer
 } // namespace cocaine
@@ -25,35 +25,156 @@
 
 #include <uuid/uuid.h>
 
-#include <openssl/sha.h>
-#include <openssl/evp.h>
-
 #include "json/json.h"
 
 #include "cocaine/dealer/utils/error.hpp"
+#include "cocaine/dealer/utils/buffer_pool.hpp"
 #include "cocaine/dealer/utils/data_container.hpp"
 
 namespace cocaine {
 namespace dealer {
 
+namespace {
+	const boost::uint64_t prime64_1 = 11400714785074694791ULL;
+	const boost::uint64_t prime64_2 = 14029467366897019727ULL;
+	const boost::uint64_t prime64_3 = 1609587929392839161ULL;
+	const boost::uint64_t prime64_4 = 9650029242287828579ULL;
+	const boost::uint64_t prime64_5 = 2870177450012600261ULL;
+
+	inline boost::uint64_t rotl64(boost::uint64_t value, int bits) {
+		return (value << bits) | (value >> (64 - bits));
+	}
+
+	inline boost::uint64_t read64(const unsigned char* ptr) {
+		boost::uint64_t value;
+		memcpy(&value, ptr, sizeof(value));
+		return value;
+	}
+
+	inline boost::uint32_t read32(const unsigned char* ptr) {
+		boost::uint32_t value;
+		memcpy(&value, ptr, sizeof(value));
+		return value;
+	}
+
+	inline boost::uint64_t xxhash64_round(boost::uint64_t acc, boost::uint64_t input) {
+		acc += input * prime64_2;
+		acc = rotl64(acc, 31);
+		return acc * prime64_1;
+	}
+
+	inline boost::uint64_t xxhash64_merge(boost::uint64_t acc, boost::uint64_t value) {
+		acc ^= xxhash64_round(0, value);
+		return acc * prime64_1 + prime64_4;
+	}
+
+	// xxhash64 with zero seed, little-endian reads
+	boost::uint64_t xxhash64(const unsigned char* data, size_t size) {
+		const unsigned char* ptr = data;
+		const unsigned char* end = data + size;
+		boost::uint64_t hash = 0;
+
+		if (size >= 32) {
+			boost::uint64_t v1 = prime64_1 + prime64_2;
+			boost::uint64_t v2 = prime64_2;
+			boost::uint64_t v3 = 0;
+			boost::uint64_t v4 = 0 - prime64_1;
+
+			const unsigned char* limit = end - 32;
+
+			do {
+				v1 = xxhash64_round(v1, read64(ptr));
+				v2 = xxhash64_round(v2, read64(ptr + 8));
+				v3 = xxhash64_round(v3, read64(ptr + 16));
+				v4 = xxhash64_round(v4, read64(ptr + 24));
+				ptr += 32;
+			} while (ptr <= limit);
+
+			hash = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+			hash = xxhash64_merge(hash, v1);
+			hash = xxhash64_merge(hash, v2);
+			hash = xxhash64_merge(hash, v3);
+			hash = xxhash64_merge(hash, v4);
+		}
+		else {
+			hash = prime64_5;
+		}
+
+		hash += static_cast<boost::uint64_t>(size);
+
+		for (; ptr + 8 <= end; ptr += 8) {
+			hash ^= xxhash64_round(0, read64(ptr));
+			hash = rotl64(hash, 27) * prime64_1 + prime64_4;
+		}
+
+		if (ptr + 4 <= end) {
+			hash ^= static_cast<boost::uint64_t>(read32(ptr)) * prime64_1;
+			hash = rotl64(hash, 23) * prime64_2 + prime64_3;
+			ptr += 4;
+		}
+
+		for (; ptr < end; ++ptr) {
+			hash ^= (*ptr) * prime64_5;
+			hash = rotl64(hash, 11) * prime64_1;
+		}
+
+		hash ^= hash >> 33;
+		hash *= prime64_2;
+		hash ^= hash >> 29;
+		hash *= prime64_3;
+		hash ^= hash >> 32;
+
+		return hash;
+	}
+}
+
 data_container::data_container() :
 	data_(NULL),
 	size_(0),
-	signed_(false)
+	signed_(0)
 {
 	init();
 }
 
 data_container::data_container(const void* data, size_t size) :
-	size_(size),
-	signed_(false)
+	data_(NULL),
+	size_(0),
+	signed_(0)
 {
+	init();
 	set_data(data, size);
 }
 
-data_container::data_container(const data_container& dc) {
+data_container::data_container(const void* data, size_t size, const boost::shared_ptr<void>& owner) :
+	data_(NULL),
+	size_(0),
+	signed_(0)
+{
+	init();
+
+	if (data == NULL || size == 0 || !owner) {
+		return;
+	}
+
+	// copying tiny data beats keeping owner alive
+	if (size <= INLINE_DATA_SIZE) {
+		set_data(data, size);
+		return;
+	}
+
+	data_ = static_cast<unsigned char*>(const_cast<void*>(data));
+	size_ = size;
+	owner_ = owner;
+}
+
+data_container::data_container(const data_container& dc) :
+	data_(NULL),
+	size_(0),
+	signed_(0)
+{
+	init();
+
 	if (dc.empty()) {
-		init();
 		return;
 	}
 
@@ -73,55 +194,59 @@ data_container::set_data(const void* data, size_t size) {
 	}
 
 	// copy provided data
-	std::string error_msg = "not enough memory to create new data container at ";
-	error_msg += std::string(BOOST_CURRENT_FUNCTION);
-
-	try {
-		data_ = new unsigned char[size];
+	if (size <= INLINE_DATA_SIZE) {
+		data_ = storage_.bytes;
 	}
-	catch (...) {
-		throw internal_error(error_msg);
-	}
-
-	if (!data_) {
-		throw internal_error(error_msg);
+	else {
+		data_ = buffer_pool_t::allocate(size);
 	}
 
 	memcpy(data_, data, size);
-	++*ref_counter_;
 	size_ = size;
+}
 
-	// data too small to compare by sha, we'll do comparisons with memcmp
-	if (size_ <= SMALL_DATA_SIZE) {
+void
+data_container::set_data(const struct iovec* segments, size_t count) {
+	// clean-up in case we have anything
+	clear();
+
+	// early exit
+	if (segments == NULL || count == 0) {
 		return;
 	}
 
-	// create sha signature
-	sign_data(data_, size_, signature_);
-	signed_ = true;
-}
-
-void
-data_container::init() {
-	// reset sha1 signature
-	signed_ = false;
-	memset(signature_, 0, SHA1_SIZE);
+	size_t size = 0;
+	for (size_t i = 0; i < count; ++i) {
+		size += segments[i].iov_len;
+	}
 
-	// create ref counter
-	std::string error_msg = "not enough memory to create new ref_counter in data container at ";
-	error_msg += std::string(BOOST_CURRENT_FUNCTION);
+	if (size == 0) {
+		return;
+	}
 
-	try {
-		ref_counter_.reset(new reference_counter(0));
+	if (size <= INLINE_DATA_SIZE) {
+		data_ = storage_.bytes;
 	}
-	catch (...) {
-		throw internal_error(error_msg);
+	else {
+		data_ = buffer_pool_t::allocate(size);
 	}
 
-	if (!ref_counter_.get()) {
-		throw internal_error(error_msg);
+	unsigned char* offset_ptr = data_;
+
+	for (size_t i = 0; i < count; ++i) {
+		memcpy(offset_ptr, segments[i].iov_base, segments[i].iov_len);
+		offset_ptr += segments[i].iov_len;
 	}
 
+	size_ = size;
+}
+
+void
+data_container::init() {
+	// reset signature
+	signed_ = 0;
+	storage_.signature = 0;
+
 	// init data
 	data_ = NULL;
 	size_ = 0;
@@ -133,37 +258,54 @@ data_container::~data_container() {
 
 void
 data_container::release() {
-	if (!ref_counter_) {
+	if (owner_) {
+		owner_.reset();
+		data_ = NULL;
 		return;
 	}
 
-	if (*ref_counter_ == 0) {
+	if (!data_ || is_inline()) {
+		data_ = NULL;
 		return;
 	}
 
-	--*ref_counter_;
-
-	if (data_ && *ref_counter_ == 0) {
-		delete [] data_;
-		data_ = NULL;
-		memset(&signature_, 0, SHA1_SIZE);
-	}
+	// copies may be released concurrently (e.g. by zmq io thread
+	// once a zero-copy frame is sent), buffer goes back to the pool
+	// with the last reference
+	buffer_pool_t::release(data_);
+	data_ = NULL;
 }
 
 data_container&
 data_container::operator = (const data_container& rhs) {
+	if (this == &rhs) {
+		return *this;
+	}
+
 	this->release();
 
-	data_ = rhs.data_;
 	size_ = rhs.size_;
-	signed_ = rhs.signed_;
+	signed_ = 0;
+	storage_.signature = 0;
+	owner_ = rhs.owner_;
+
+	if (rhs.is_inline()) {
+		memcpy(storage_.bytes, rhs.storage_.bytes, size_);
+		data_ = storage_.bytes;
+		return *this;
+	}
+
+	data_ = rhs.data_;
 
+	// copies share data, so they share signature too
 	if (rhs.signed_) {
-		memcpy(signature_, rhs.signature_, SHA1_SIZE);
+		storage_.signature = rhs.storage_.signature;
+		signed_ = 1;
 	}
 
-	ref_counter_ = rhs.ref_counter_;
-	++*ref_counter_;
+	if (data_ && !owner_) {
+		buffer_pool_t::add_ref(data_);
+	}
 
 	return *this;
 }
@@ -185,8 +327,18 @@ data_container::operator == (const data_container& rhs) const {
 		return (0 == memcmp(data_, rhs.data_, size_));
 	}
 
-	// compare big containers
-	return (0 == memcmp(signature_, rhs.signature_, SHA1_SIZE));
+	// same memory
+	if (data_ == rhs.data_) {
+		return true;
+	}
+
+	// compare big containers by signature first, signatures are cached
+	// so repeated comparisons of different data take no pass over it
+	if (signature() != rhs.signature()) {
+		return false;
+	}
+
+	return (0 == memcmp(data_, rhs.data_, size_));
 }
 
 bool
@@ -215,39 +367,43 @@ data_container::size() const {
 	return size_;
 }
 
-void
-data_container::sign_data(unsigned char* data, size_t& size, unsigned char signature[SHA1_SIZE]) {
-	SHA_CTX sha_context;
-	SHA1_Init(&sha_context);
+const data_container&
+data_container::buffer() const {
+	return *this;
+}
 
-	// reset signature
-	memset(signature, 0, SHA1_SIZE);
+bool
+data_container::retain_buffer() const {
+	if (!data_ || owner_ || is_inline()) {
+		return false;
+	}
 
-	// go through compiled and flattened data in chunks of 512 kb., building signature
-	unsigned int full_chunks_count = size / SHA1_CHUNK_SIZE;
-	char* data_offset_ptr = (char*)data;
+	buffer_pool_t::add_ref(data_);
+	return true;
+}
 
-	// process full chunks
-	for (unsigned i = 0; i < full_chunks_count; i++) {
-		SHA1_Update(&sha_context, data_offset_ptr, SHA1_CHUNK_SIZE);
-		data_offset_ptr += SHA1_CHUNK_SIZE;
-	}
+bool
+data_container::is_inline() const {
+	return data_ == storage_.bytes;
+}
 
-	unsigned int remainder_chunk_size = 0;
+void
+data_container::release_buffer(void* data) {
+	buffer_pool_t::release(static_cast<unsigned char*>(data));
+}
 
-	if (size < SHA1_CHUNK_SIZE) {
-		remainder_chunk_size = size;
-	}
-	else {
-		remainder_chunk_size = size % SHA1_CHUNK_SIZE;
+boost::uint64_t
+data_container::signature() const {
+	if (signed_) {
+		return storage_.signature;
 	}
 
-	// process remained chunk
-	if (0 != remainder_chunk_size) {
-		SHA1_Update(&sha_context, data_offset_ptr, remainder_chunk_size);
-	}
+	// racing threads compute the same value
+	storage_.signature = xxhash64(data_, size_);
+	__sync_synchronize();
+	signed_ = 1;
 
-	SHA1_Final(signature, &sha_context);
+	return storage_.signature;
 }
 
 bool
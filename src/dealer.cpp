@@ -18,6 +18,7 @@
     along with this program. If not, see <http://www.gnu.org/licenses/>. 
 */
 
+#include <cstdlib>
 #include <stdexcept>
 
 #include <boost/current_function.hpp>
@@ -43,6 +44,11 @@ dealer_t::send_message(const message_t& message) {
     return m_impl->send_message(message);   
 }
 
+std::vector<boost::shared_ptr<response_t> >
+dealer_t::send_messages_batch(const std::vector<message_t>& messages) {
+	return m_impl->send_messages_batch(messages);
+}
+
 boost::shared_ptr<response_t>
 dealer_t::send_message(const void* data,
                        size_t size,
@@ -92,6 +98,132 @@ dealer_t::send_message(const std::string& data,
     return m_impl->send_message(data.data(), data.size(), path);
 }
 
+void
+dealer_t::send_message(const void* data,
+                       size_t size,
+                       const message_path_t& path,
+                       const message_policy_t& policy,
+                       const response_chunk_callback_t& on_chunk,
+                       const response_complete_callback_t& on_complete)
+{
+    m_impl->send_message(data, size, path, policy, on_chunk, on_complete);
+}
+
+void
+dealer_t::send_message(const std::string& data,
+                       const message_path_t& path,
+                       const message_policy_t& policy,
+                       const response_chunk_callback_t& on_chunk,
+                       const response_complete_callback_t& on_complete)
+{
+    m_impl->send_message(data.data(), data.size(), path, policy, on_chunk, on_complete);
+}
+
+void
+dealer_t::send_message(const void* data,
+                       size_t size,
+                       const message_path_t& path,
+                       const message_policy_t& policy,
+                       const boost::shared_ptr<completion_queue_t>& queue,
+                       boost::uint64_t tag)
+{
+    m_impl->send_message(data, size, path, policy, queue, tag);
+}
+
+void
+dealer_t::send_message(const std::string& data,
+                       const message_path_t& path,
+                       const message_policy_t& policy,
+                       const boost::shared_ptr<completion_queue_t>& queue,
+                       boost::uint64_t tag)
+{
+    m_impl->send_message(data.data(), data.size(), path, policy, queue, tag);
+}
+
+boost::shared_ptr<response_t>
+dealer_t::send_message(const struct iovec* segments,
+                       size_t count,
+                       const message_path_t& path,
+                       const message_policy_t& policy)
+{
+    data_container data;
+    data.set_data(segments, count);
+    return m_impl->send_message(data, path, policy);
+}
+
+boost::shared_ptr<response_t>
+dealer_t::send_message(const struct iovec* segments,
+                       size_t count,
+                       const boost::shared_ptr<void>& owner,
+                       const message_path_t& path,
+                       const message_policy_t& policy)
+{
+    // wire frame is contiguous, several segments still need a gather
+    if (segments == NULL || count != 1 || !owner) {
+        return send_message(segments, count, path, policy);
+    }
+
+    data_container data(segments[0].iov_base, segments[0].iov_len, owner);
+    return m_impl->send_message(data, path, policy);
+}
+
+boost::shared_ptr<response_t>
+dealer_t::send_message(std::string&& data,
+                       const message_path_t& path,
+                       const message_policy_t& policy)
+{
+    boost::shared_ptr<std::string> owner(new std::string);
+    owner->swap(data);
+
+    return send_shared_data(data_container(owner->data(), owner->size(), owner), path, policy);
+}
+
+boost::shared_ptr<response_t>
+dealer_t::send_message(std::string&& data,
+                       const message_path_t& path)
+{
+    boost::shared_ptr<std::string> owner(new std::string);
+    owner->swap(data);
+
+    return send_shared_data(data_container(owner->data(), owner->size(), owner), path);
+}
+
+boost::shared_ptr<response_t>
+dealer_t::send_message(msgpack::sbuffer& buffer,
+                       const message_path_t& path,
+                       const message_policy_t& policy)
+{
+    size_t size = buffer.size();
+    boost::shared_ptr<void> owner(buffer.release(), &free);
+
+    return send_shared_data(data_container(owner.get(), size, owner), path, policy);
+}
+
+boost::shared_ptr<response_t>
+dealer_t::send_message(msgpack::sbuffer& buffer,
+                       const message_path_t& path)
+{
+    size_t size = buffer.size();
+    boost::shared_ptr<void> owner(buffer.release(), &free);
+
+    return send_shared_data(data_container(owner.get(), size, owner), path);
+}
+
+boost::shared_ptr<response_t>
+dealer_t::send_shared_data(const data_container& data,
+                           const message_path_t& path,
+                           const message_policy_t& policy)
+{
+    return m_impl->send_message(data, path, policy);
+}
+
+boost::shared_ptr<response_t>
+dealer_t::send_shared_data(const data_container& data,
+                           const message_path_t& path)
+{
+    return m_impl->send_message(data, path);
+}
+
 std::vector<boost::shared_ptr<response_t> >
 dealer_t::send_messages(const std::string& data,
                         const message_path_t& path,
@@ -20,6 +20,7 @@
 
 #include <stdexcept>
 
+#include <boost/bind.hpp>
 #include <boost/current_function.hpp>
 
 #include "cocaine/dealer/core/cached_message.hpp"
@@ -176,14 +177,71 @@ dealer_impl_t::send_message(const void* data,
 							const message_policy_t& policy)
 {
 	BOOST_VERIFY(!m_is_dead);
-	
-	boost::mutex::scoped_lock lock(m_mutex);
+
+	boost::shared_ptr<service_t> service = get_service(path.service_alias);
+	dispatch_message_ptr_t msg = create_message(data, size, path, policy);
+
+	return service->send_message(msg);
+}
+
+void
+dealer_impl_t::send_message(const void* data,
+							size_t size,
+							const message_path_t& path,
+							const message_policy_t& policy,
+							const response_chunk_callback_t& on_chunk,
+							const response_complete_callback_t& on_complete)
+{
+	BOOST_VERIFY(!m_is_dead);
+
+	boost::shared_ptr<service_t> service = get_service(path.service_alias);
+	dispatch_message_ptr_t msg = create_message(data, size, path, policy);
+
+	service->send_message(msg, on_chunk, on_complete);
+}
+
+void
+dealer_impl_t::send_message(const void* data,
+							size_t size,
+							const message_path_t& path,
+							const message_policy_t& policy,
+							const boost::shared_ptr<completion_queue_t>& queue,
+							boost::uint64_t tag)
+{
+	if (!queue) {
+		throw internal_error("no completion queue given at " + std::string(BOOST_CURRENT_FUNCTION));
+	}
+
+	// callbacks keep the queue alive until the response is over
+	send_message(data,
+				 size,
+				 path,
+				 policy,
+				 boost::bind(&completion_queue_t::push_chunk, queue, tag, _1),
+				 boost::bind(&completion_queue_t::push_complete, queue, tag, _1, _2));
+}
+
+boost::shared_ptr<response_t>
+dealer_impl_t::send_message(const data_container& data,
+							const message_path_t& path,
+							const message_policy_t& policy)
+{
+	BOOST_VERIFY(!m_is_dead);
+
 	boost::shared_ptr<service_t> service = get_service(path.service_alias);
-	boost::shared_ptr<message_iface> msg = create_message(data, size, path, policy);
+	dispatch_message_ptr_t msg = create_message(data, path, policy);
 
 	return service->send_message(msg);
 }
 
+boost::shared_ptr<response_t>
+dealer_impl_t::send_message(const data_container& data,
+							const message_path_t& path)
+{
+	boost::shared_ptr<service_t> service = get_service(path.service_alias);
+	return dealer_impl_t::send_message(data, path, service->info().policy);
+}
+
 std::vector<boost::shared_ptr<response_t> >
 dealer_impl_t::send_messages(const void* data,
 							 size_t size,
@@ -229,6 +287,55 @@ dealer_impl_t::send_messages(const void* data,
 	return responces_list;
 }
 
+std::vector<boost::shared_ptr<response_t> >
+dealer_impl_t::send_messages_batch(const std::vector<message_t>& messages) {
+	BOOST_VERIFY(!m_is_dead);
+
+	std::vector<boost::shared_ptr<response_t> > responces_list(messages.size());
+
+	// <service alias, indexes of messages>
+	typedef std::map<std::string, std::vector<size_t> > service_messages_t;
+	service_messages_t service_messages;
+
+	for (size_t i = 0; i < messages.size(); ++i) {
+		service_messages[messages[i].path.service_alias].push_back(i);
+	}
+
+	// resolve every service first so an unknown alias fails the whole
+	// batch before any message is enqueued
+	std::vector<boost::shared_ptr<service_t> > services;
+	services.reserve(service_messages.size());
+
+	service_messages_t::const_iterator it = service_messages.begin();
+	for (; it != service_messages.end(); ++it) {
+		services.push_back(get_service(it->first));
+	}
+
+	it = service_messages.begin();
+	for (size_t s = 0; it != service_messages.end(); ++it, ++s) {
+		const std::vector<size_t>& indexes = it->second;
+
+		std::vector<dispatch_message_ptr_t > msgs;
+		msgs.reserve(indexes.size());
+
+		for (size_t i = 0; i < indexes.size(); ++i) {
+			const message_t& message = messages[indexes[i]];
+			msgs.push_back(create_message(message.data,
+										  message.path,
+										  message.policy));
+		}
+
+		std::vector<boost::shared_ptr<response_t> > service_responces;
+		services[s]->send_messages(msgs, service_responces);
+
+		for (size_t i = 0; i < indexes.size(); ++i) {
+			responces_list[indexes[i]] = service_responces[i];
+		}
+	}
+
+	return responces_list;
+}
+
 message_policy_t
 dealer_impl_t::policy_for_service(const std::string& service_alias) {
 	boost::shared_ptr<service_t> service;
@@ -288,26 +395,33 @@ dealer_impl_t::disconnect() {
 	m_services.clear();
 }
 
-boost::shared_ptr<message_iface>
+dispatch_message_ptr_t
 dealer_impl_t::create_message(const void* data,
 							  size_t size,
 							  const message_path_t& path,
 							  const message_policy_t& policy)
 {
-	typedef cached_message_t<data_container, request_metadata_t> msg_t;
-	boost::shared_ptr<message_iface> msg(new msg_t(path,
-												   policy,
-												   data,
-												   size));
+	return create_message(data_container(data, size), path, policy);
+}
+
+dispatch_message_ptr_t
+dealer_impl_t::create_message(const data_container& data,
+							  const message_path_t& path,
+							  const message_policy_t& policy)
+{
+	dispatch_message_ptr_t msg(new dispatch_message_t(path, policy, data));
 
 	if (config()->message_cache_type() == PERSISTENT &&
 		policy.persistent == true)
 	{
 		boost::shared_ptr<eblob_t> eb = context()->storage()->get_eblob(path.service_alias);
 		msg->commit_to_eblob(eb);
-		log(PLOG_DEBUG,
-			"commited message with uuid: %s to persistent storage.",
-			msg->uuid().as_human_readable_string().c_str());
+
+		if (log_flag_enabled(PLOG_DEBUG)) {
+			log(PLOG_DEBUG,
+				"commited message with uuid: %s to persistent storage.",
+				msg->uuid().as_human_readable_string().c_str());
+		}
 	}
 
 	return msg;
@@ -40,7 +40,8 @@ handle_t::handle_t(const handle_info_t& info,
 	m_endpoints(endpoints),
 	m_is_running(false),
 	m_is_connected(false),
-	m_receiving_control_socket_ok(false)
+	m_receiving_control_socket_ok(false),
+	m_has_pending_work(false)
 {
 	log(PLOG_DEBUG, "CREATED HANDLE " + description());
 
@@ -55,9 +56,18 @@ handle_t::handle_t(const handle_info_t& info,
 	m_zmq_control_socket->setsockopt(ZMQ_LINGER, &timeout, sizeof(timeout));
 	m_zmq_control_socket->bind(conn_str.c_str());
 
-	// run message dispatch thread
+	// run message dispatch on one of the shared reactors
 	m_is_running = true;
-	m_thread = boost::thread(&handle_t::dispatch_messages, this);
+	m_reactor = context()->reactor_for(description());
+
+	try {
+		m_reactor->attach(this);
+	}
+	catch (const std::exception& ex) {
+		m_is_running = false;
+		log(PLOG_ERROR, "could not attach handle %s to reactor, details: %s", description().c_str(), ex.what());
+		throw;
+	}
 }
 
 handle_t::~handle_t() {
@@ -91,96 +101,148 @@ handle_t::kill() {
 
 	m_is_running = false;
 
+	// stop message dispatch, finalize everything
+	m_reactor->detach(this);
+
 	m_zmq_control_socket->close();
 	m_zmq_control_socket.reset(NULL);
 
-	m_thread.join();
-
 	log(PLOG_DEBUG, "KILLED HANDLE " + description());
 }
 
 void
-handle_t::dispatch_messages() {
+handle_t::start_dispatch() {
 	wuuid_t balancer_uuid;
 	balancer_uuid.generate();
 	std::string balancer_ident = m_info.as_string() + "." + balancer_uuid.as_human_readable_string();
 
-	balancer_t balancer(balancer_ident, m_endpoints, context());
+	service_info_t service_info;
+	config()->service_info_by_name(m_info.service_alias, service_info);
+
+	m_balancer.reset(new balancer_t(balancer_ident,
+									m_endpoints,
+									context(),
+									m_message_cache,
+									service_info.balancing_type));
 	m_is_connected = true;
 
-	socket_ptr_t control_socket;
-	establish_control_conection(control_socket);
+	establish_control_conection(m_control_socket);
+
+	m_has_pending_work = (m_message_cache->new_messages_count() > 0);
 
 	log(PLOG_DEBUG, "started message dispatch for " + description());
+}
 
-	m_last_response_timer.reset();
-	m_deadlined_messages_timer.reset();
-	m_control_messages_timer.reset();
-
-	// process messages
-	while (m_is_running) {
-		// process incoming control messages every 200 msec
-		int control_message = 0;
-		              
-		if (m_control_messages_timer.elapsed().as_double() > 0.2f) {
-		      control_message = receive_control_messages(control_socket, 0);
-		      m_control_messages_timer.reset();
-		}
+void
+handle_t::stop_dispatch() {
+	m_control_socket.reset();
+	m_balancer.reset();
+	m_is_connected = false;
 
-		if (control_message == CONTROL_MESSAGE_KILL) {
-			// stop message dispatch, finalize everything
-			m_is_running = false;
-			break;
-		}
-		else if (control_message > 0) {
+	log(PLOG_DEBUG, "finished message dispatch for " + description());
+}
+
+void
+handle_t::abort_dispatch(const std::string& error) {
+	log(PLOG_ERROR, "message dispatch failed for %s, handle is dead, details: %s", description().c_str(), error.c_str());
+
+	// reactor no longer serves this handle, kill() must not wait on it
+	m_is_running = false;
+
+	// senders fall back to service unhandled queue
+	m_message_cache->close_intake();
+
+	try {
+		stop_dispatch();
+	}
+	catch (...) {
+	}
+}
+
+void
+handle_t::fill_poll_items(zmq_pollitem_t* poll_items) {
+	poll_items[0].socket = *m_control_socket;
+	poll_items[0].fd = 0;
+	poll_items[0].events = ZMQ_POLLIN;
+	poll_items[0].revents = 0;
+
+	poll_items[1].socket = m_balancer->socket();
+	poll_items[1].fd = 0;
+	poll_items[1].events = ZMQ_POLLIN;
+	poll_items[1].revents = 0;
+
+	poll_items[2].socket = NULL;
+	poll_items[2].fd = m_message_cache->wakeup_fd();
+	poll_items[2].events = ZMQ_POLLIN;
+	poll_items[2].revents = 0;
+}
+
+long
+handle_t::poll_timeout() {
+	if (m_has_pending_work) {
+		return 0;
+	}
+
+	// block until control message, response, new message or message timer
+	return m_message_cache->timers_timeout();
+}
+
+void
+handle_t::process_poll_items(const zmq_pollitem_t* poll_items) {
+	if (!m_is_running) {
+		return;
+	}
+
+	balancer_t& balancer = *m_balancer;
+
+	// process incoming control messages
+	if ((ZMQ_POLLIN & poll_items[0].revents) == ZMQ_POLLIN) {
+		int control_message = receive_control_messages(m_control_socket, 0);
+
+		while (control_message > 0) {
 			dispatch_control_messages(control_message, balancer);
+			control_message = receive_control_messages(m_control_socket, 0);
 		}
+	}
 
-		// send new message if any
-		if (m_is_running && m_is_connected) {
-			for (int i = 0; i < 100; ++i) { // batching
-				if (m_message_cache->new_messages_count() == 0) {
-					break;
-				}
+	m_has_pending_work = false;
 
-				dispatch_next_available_message(balancer);
-			}
+	// process received responce(s)
+	if (m_is_connected && (ZMQ_POLLIN & poll_items[1].revents) == ZMQ_POLLIN) {
+		int i = 0;
+		for (; i < dispatch_batch_size && balancer.check_for_responses(0); ++i) {
+			dispatch_next_available_response(balancer);
 		}
 
-		// check for message responces
-		bool received_response = false;
-
-		int fast_poll_timeout = 30;		  // microsecs
-		int long_poll_timeout = 300000;   // microsecs
+		m_has_pending_work = (i == dispatch_batch_size);
+	}
 
-		int response_poll_timeout = fast_poll_timeout;
-		if (m_last_response_timer.elapsed().as_double() > 5.0f) {
-			response_poll_timeout = long_poll_timeout;
-		}
+	// only due message timers are visited
+	process_deadlined_messages();
 
-		if (m_is_connected && m_is_running) {
-			received_response = balancer.check_for_responses(response_poll_timeout);
+	// reset wakeup notification before looking into the queue
+	if ((ZMQ_POLLIN & poll_items[2].revents) == ZMQ_POLLIN) {
+		m_message_cache->drain_wakeup();
+	}
 
-			// process received responce(s)
-			while (received_response) {
-				m_last_response_timer.reset();
-				response_poll_timeout = fast_poll_timeout;
+	// send new messages if any, stop at first failed send and
+	// wait for endpoints update or next event before retrying
+	if (m_is_connected) {
+		int i = 0;
+		for (; i < dispatch_batch_size; ++i) { // batching
+			if (m_message_cache->new_messages_count() == 0) {
+				break;
+			}
 
-				dispatch_next_available_response(balancer);
-				received_response = balancer.check_for_responses(response_poll_timeout);
+			if (!dispatch_next_available_message(balancer)) {
+				break;
 			}
 		}
 
-		if (m_is_running) {
-			if (m_deadlined_messages_timer.elapsed().as_double() > 1.0f) {
-				process_deadlined_messages();
-				m_deadlined_messages_timer.reset();
-			}
+		if (i == dispatch_batch_size && m_message_cache->new_messages_count() > 0) {
+			m_has_pending_work = true;
 		}
 	}
-
-	control_socket.reset();
-	log(PLOG_DEBUG, "finished message dispatch for " + description());
 }
 
 void
@@ -189,7 +251,7 @@ handle_t::remove_from_persistent_storage(const boost::shared_ptr<response_chunk_
 		return;
 	}
 
-	boost::shared_ptr<message_iface> sent_msg;
+	dispatch_message_ptr_t sent_msg;
 	if (false == m_message_cache->get_sent_message(response->route, response->uuid, sent_msg)) {
 		return;
 	}
@@ -204,7 +266,7 @@ handle_t::remove_from_persistent_storage(const boost::shared_ptr<response_chunk_
 }
 
 void
-handle_t::remove_from_persistent_storage(wuuid_t& uuid,
+handle_t::remove_from_persistent_storage(const wuuid_t& uuid,
 										 const message_policy_t& policy,
 										 const std::string& alias)
 {
@@ -229,12 +291,13 @@ handle_t::dispatch_next_available_response(balancer_t& balancer) {
 		return;
 	}
 
-	boost::shared_ptr<message_iface> sent_msg;
+	dispatch_message_ptr_t sent_msg;
 
 	switch (response->rpc_code) {
 		case SERVER_RPC_MESSAGE_ACK:		
 			if (m_message_cache->get_sent_message(response->route, response->uuid, sent_msg)) {
-				sent_msg->set_ack_received(true);
+				m_message_cache->mark_ack_received(sent_msg);
+				balancer.register_ack(response->route, message_latency(sent_msg));
 			}
 		break;
 
@@ -243,6 +306,10 @@ handle_t::dispatch_next_available_response(balancer_t& balancer) {
 		break;
 
 		case SERVER_RPC_MESSAGE_CHOKE:
+			if (m_message_cache->get_sent_message(response->route, response->uuid, sent_msg)) {
+				balancer.register_response(response->route, message_latency(sent_msg));
+			}
+
 			enqueue_response(response);
 
 			remove_from_persistent_storage(response);
@@ -311,6 +378,14 @@ handle_t::dispatch_next_available_response(balancer_t& balancer) {
 	}
 }
 
+double
+handle_t::message_latency(const dispatch_message_ptr_t& message) {
+	nanoseconds_t curr_time = monotonic_clock_t::loop_now();
+	nanoseconds_t sent_time = message->sent_at();
+
+	return (curr_time > sent_time) ? monotonic_clock_t::to_seconds(curr_time - sent_time) : 0.0;
+}
+
 namespace {
 	struct resheduler {
 		resheduler(const boost::shared_ptr<message_cache_t>& cache) : m_cache(cache) {
@@ -521,11 +596,11 @@ handle_t::dispatch_next_available_message(balancer_t& balancer) {
 		return false;
 	}
 
-	boost::shared_ptr<message_iface> new_msg = m_message_cache->get_new_message();
-	cocaine_endpoint_t endpoint;
+	dispatch_message_ptr_t new_msg = m_message_cache->get_new_message();
+	const cocaine_endpoint_t* endpoint = NULL;
 	if (balancer.send(new_msg, endpoint)) {
 		new_msg->mark_as_sent(true);
-		m_message_cache->move_new_message_to_sent(endpoint.route);
+		m_message_cache->move_new_message_to_sent(endpoint->route);
 
 		if (log_flag_enabled(PLOG_DEBUG)) {
 			std::string log_msg = "sent msg with uuid: %s to endpoint: %s with route: %s (%s)";
@@ -534,7 +609,7 @@ handle_t::dispatch_next_available_message(balancer_t& balancer) {
 			log(PLOG_DEBUG,
 				log_msg.c_str(),
 				new_msg->uuid().as_human_readable_string().c_str(),
-				endpoint.endpoint.c_str(),
+				endpoint->endpoint.c_str(),
 				description().c_str(),
 				sent_timestamp_str.c_str());
 		}
@@ -581,10 +656,10 @@ handle_t::make_all_messages_new() {
 	m_message_cache->make_all_messages_new();
 }
 
-void
+bool
 handle_t::assign_message_queue(const message_cache_t::message_queue_ptr_t& message_queue) {
 	assert (m_message_cache);
-	m_message_cache->append_message_queue(message_queue);
+	return m_message_cache->append_message_queue(message_queue);
 }
 
 void
@@ -593,9 +668,9 @@ handle_t::set_responce_callback(responce_callback_t callback) {
 	m_response_callback = callback;
 }
 
-void
-handle_t::enqueue_message(const boost::shared_ptr<message_iface>& message) {
-	m_message_cache->enqueue(message);
+bool
+handle_t::enqueue_message(const dispatch_message_ptr_t& message) {
+	return m_message_cache->enqueue(message);
 }
 
 } // namespace dealer
@@ -0,0 +1,91 @@
+/*
+    Copyright (c) 2011-2012 Rim Zaidullin <creator@bash.org.ru>
+    Copyright (c) 2011-2012 Other contributors as noted in the AUTHORS file.
+
+    This file is part of Cocaine.
+
+    Cocaine is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Cocaine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>. 
+*/
+
+#include <cstring>
+
+#include <uuid/uuid.h>
+
+#include <boost/thread/once.hpp>
+
+#include "cocaine/dealer/utils/id_generator.hpp"
+
+namespace cocaine {
+namespace dealer {
+
+namespace {
+	boost::once_flag process_prefix_flag = BOOST_ONCE_INIT;
+
+	// ids left in current block of the thread
+	struct thread_block_t {
+		boost::uint64_t next;
+		boost::uint64_t end;
+	};
+
+	__thread thread_block_t thread_block = { 0, 0 };
+}
+
+volatile int id_generator_t::m_sequential = 0;
+boost::uint64_t id_generator_t::m_process_prefix = 0;
+volatile boost::uint32_t id_generator_t::m_last_block = 0;
+
+void
+id_generator_t::set_sequential(bool sequential) {
+	if (sequential) {
+		boost::call_once(&id_generator_t::init_process_prefix, process_prefix_flag);
+	}
+
+	m_sequential = sequential ? 1 : 0;
+}
+
+void
+id_generator_t::generate(unsigned char id[ID_SIZE]) {
+	if (m_sequential) {
+		generate_sequential(id);
+		return;
+	}
+
+	uuid_generate(id);
+}
+
+void
+id_generator_t::generate_sequential(unsigned char id[ID_SIZE]) {
+	// block of 2^32 ids, next one is taken once it's used up
+	if (thread_block.next == thread_block.end) {
+		boost::uint64_t block = __sync_add_and_fetch(&m_last_block, 1);
+		thread_block.next = block << 32;
+		thread_block.end = thread_block.next + (1ULL << 32);
+	}
+
+	boost::uint64_t counter = thread_block.next++;
+
+	memcpy(id, &m_process_prefix, sizeof(m_process_prefix));
+	memcpy(id + sizeof(m_process_prefix), &counter, sizeof(counter));
+}
+
+void
+id_generator_t::init_process_prefix() {
+	// random bytes from libuuid keep ids of different runs apart
+	uuid_t seed;
+	uuid_generate(seed);
+	memcpy(&m_process_prefix, seed, sizeof(m_process_prefix));
+}
+
+} // namespace dealer
+} // namespace cocaine
@@ -27,6 +27,7 @@
 #include <iostream>
 
 #include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
 #include <boost/tokenizer.hpp>
 #include <boost/progress.hpp>
 
@@ -39,7 +40,10 @@ namespace dealer {
 message_cache_t::message_cache_t(const boost::shared_ptr<context_t>& ctx,
 							 bool logging_enabled) :
 	dealer_object_t(ctx, logging_enabled),
-	m_locked(false)
+	m_locked(false),
+	m_expired_new_messages(0),
+	m_intake_producers(0),
+	m_intake_closed(0)
 {
 	m_type = config()->message_cache_type();
 	m_new_messages.reset(new message_queue_t);
@@ -56,132 +60,175 @@ message_cache_t::new_messages() {
 		throw internal_error(error_str);
 	}
 
+	drain_intake();
+	compact_new_messages();
+
 	return m_new_messages;
 }
 
 void
-message_cache_t::enqueue_with_priority(const boost::shared_ptr<message_iface>& message) {
-	boost::mutex::scoped_lock lock(m_mutex);
-	m_new_messages->push_front(message);
+message_cache_t::enqueue_with_priority(const dispatch_message_ptr_t& message) {
+	m_intake.push(std::make_pair(message, true));
+	m_wakeup.notify();
 }
 
-void
-message_cache_t::enqueue(const boost::shared_ptr<message_iface>& message) {
-	boost::mutex::scoped_lock lock(m_mutex);
-	m_new_messages->push_back(message);
+bool
+message_cache_t::enqueue(const dispatch_message_ptr_t& message) {
+	if (!enter_intake()) {
+		return false;
+	}
+
+	m_intake.push(std::make_pair(message, false));
+	leave_intake();
+
+	m_wakeup.notify();
+	return true;
 }
 
-void
+bool
 message_cache_t::append_message_queue(message_queue_ptr_t queue) {
-	boost::mutex::scoped_lock lock(m_mutex);
-
 	// validate new queue
 	if (!queue || queue->empty()) {
-		return;
+		return true;
 	}
 
 	// append messages
-	m_new_messages->insert(m_new_messages->end(), queue->begin(), queue->end());
+	std::vector<intake_entry_t> entries;
+	entries.reserve(queue->size());
+
+	for (message_queue_t::iterator it = queue->begin(); it != queue->end(); ++it) {
+		entries.push_back(std::make_pair(*it, false));
+	}
+
+	if (!enter_intake()) {
+		return false;
+	}
+
+	m_intake.push(entries.begin(), entries.end());
+	leave_intake();
+
+	m_wakeup.notify();
+	return true;
+}
+
+void
+message_cache_t::close_intake() {
+	m_intake_closed = 1;
+	__sync_synchronize();
+
+	while (m_intake_producers != 0) {
+		boost::this_thread::yield();
+	}
+}
+
+bool
+message_cache_t::enter_intake() {
+	// full barrier, pairs with the one in close_intake()
+	__sync_fetch_and_add(&m_intake_producers, 1);
+
+	if (m_intake_closed) {
+		leave_intake();
+		return false;
+	}
+
+	return true;
+}
+
+void
+message_cache_t::leave_intake() {
+	__sync_fetch_and_sub(&m_intake_producers, 1);
+}
+
+void
+message_cache_t::drain_intake() {
+	if (m_intake.empty()) {
+		return;
+	}
+
+	m_intake_batch.clear();
+	m_intake.pop_all(m_intake_batch);
+
+	for (size_t i = 0; i < m_intake_batch.size(); ++i) {
+		const cached_message_ptr_t& msg = m_intake_batch[i].first;
+
+		if (m_intake_batch[i].second) {
+			m_new_messages->push_front(msg);
+		}
+		else {
+			m_new_messages->push_back(msg);
+		}
+
+		arm_deadline_timer(msg);
+	}
+
+	m_intake_batch.clear();
 }
 
-boost::shared_ptr<message_iface>
+dispatch_message_ptr_t
 message_cache_t::get_new_message() {
-	boost::mutex::scoped_lock lock(m_mutex);
+	drain_intake();
+	skip_expired_new_messages();
+
 	return m_new_messages->front();
 }
 
 size_t
 message_cache_t::new_messages_count() {
-	boost::mutex::scoped_lock lock(m_mutex);
-	return m_new_messages->size();
+	drain_intake();
+	return m_new_messages->size() - m_expired_new_messages;
 }
 
 size_t
 message_cache_t::sent_messages_count() {
-	boost::mutex::scoped_lock lock(m_mutex);
-
-	size_t sent_messages_count = 0;
-
-	route_sent_messages_map_t::const_iterator it = m_sent_messages.begin();
-	for (; it != m_sent_messages.end(); ++it) {
-		sent_messages_count += it->second.size();
-	}
+	return m_sent_messages.size();
+}
 
-	return sent_messages_count;
+size_t
+message_cache_t::sent_messages_count(const std::string& route) {
+	return m_sent_messages.route_size(route);
 }
 
 bool
 message_cache_t::get_sent_message(const std::string& route,
-								  wuuid_t& uuid,
-								  boost::shared_ptr<message_iface>& message)
+								  const wuuid_t& uuid,
+								  dispatch_message_ptr_t& message)
 {
-	boost::mutex::scoped_lock lock(m_mutex);
-
-	route_sent_messages_map_t::const_iterator it = m_sent_messages.find(route);
-
-	if (it == m_sent_messages.end()) {
-		return false;
-	}
-
-	const sent_messages_map_t& msg_map = it->second;
-	sent_messages_map_t::const_iterator mit = msg_map.find(uuid.as_string());
-
-	if (mit == msg_map.end()) {
+	if (!m_sent_messages.find(route, uuid, message)) {
 		return false;
 	}
 
-	assert(mit->second);
-	message = mit->second;
-
+	assert(message);
 	return true;
 }
 
 void
 message_cache_t::move_new_message_to_sent(const std::string& route) {
-	boost::mutex::scoped_lock lock(m_mutex);
+	skip_expired_new_messages();
 
-	boost::shared_ptr<message_iface> msg = m_new_messages->front();
+	dispatch_message_ptr_t msg = m_new_messages->front();
 	assert(msg);
 
-	route_sent_messages_map_t::iterator it = m_sent_messages.find(route);
-	if (it == m_sent_messages.end()) {
-		sent_messages_map_t msg_map;
-		msg_map.insert(std::make_pair(msg->uuid().as_string(), msg));
-		m_sent_messages[route] = msg_map;
-	}
-	else {
-		it->second.insert(std::make_pair(msg->uuid().as_string(), msg));
-	}
-
+	m_sent_messages.insert(route, msg);
 	m_new_messages->pop_front();
+
+	arm_ack_timer(msg);
 }
 
 bool
-message_cache_t::reshedule_message(const std::string& route, wuuid_t& uuid) {
-	boost::mutex::scoped_lock lock(m_mutex);
-
-	route_sent_messages_map_t::iterator it = m_sent_messages.find(route);
-
-	if (it == m_sent_messages.end()) {
-		return false;
-	}
-
-	sent_messages_map_t& msg_map = it->second;
-	sent_messages_map_t::iterator mit = msg_map.find(uuid.as_string());
-
-	if (mit == msg_map.end()) {
+message_cache_t::reshedule_message(const std::string& route, const wuuid_t& uuid) {
+	dispatch_message_ptr_t msg;
+	if (!m_sent_messages.find(route, uuid, msg)) {
 		return false;
 	}
 
-	boost::shared_ptr<message_iface> msg = mit->second;
-
 	if (!msg) {
 		throw internal_error("empty cached message object at " + std::string(BOOST_CURRENT_FUNCTION));
 	}
 
 	if (msg->can_retry()) {
 		msg->increment_retries_count();
-		msg_map.erase(mit);
+		m_sent_messages.erase(route, uuid, msg);
+		cancel_ack_timer(msg);
 
 		msg->mark_as_sent(false);
 		msg->set_ack_received(false);
@@ -195,29 +242,17 @@ message_cache_t::reshedule_message(const std::string& route, wuuid_t& uuid) {
 }
 
 void
-message_cache_t::move_sent_message_to_new(const std::string& route, wuuid_t& uuid) {
-	boost::mutex::scoped_lock lock(m_mutex);
-
-	route_sent_messages_map_t::iterator it = m_sent_messages.find(route);
-
-	if (it == m_sent_messages.end()) {
+message_cache_t::move_sent_message_to_new(const std::string& route, const wuuid_t& uuid) {
+	dispatch_message_ptr_t msg;
+	if (!m_sent_messages.erase(route, uuid, msg)) {
 		return;
 	}
 
-	sent_messages_map_t& msg_map = it->second;
-	sent_messages_map_t::iterator mit = msg_map.find(uuid.as_string());
-
-	if (mit == msg_map.end()) {
-		return;
-	}
-
-	boost::shared_ptr<message_iface> msg = mit->second;
-
 	if (!msg) {
 		throw internal_error("empty cached message object at " + std::string(BOOST_CURRENT_FUNCTION));
 	}
 
-	msg_map.erase(mit);
+	cancel_ack_timer(msg);
 
 	msg->mark_as_sent(false);
 	msg->set_ack_received(false);
@@ -226,169 +261,207 @@ message_cache_t::move_sent_message_to_new(const std::string& route, wuuid_t& uui
 }
 
 void
-message_cache_t::move_sent_message_to_new_front(const std::string& route, wuuid_t& uuid) {
-	boost::mutex::scoped_lock lock(m_mutex);
-
-	route_sent_messages_map_t::iterator it = m_sent_messages.find(route);
-
-	if (it == m_sent_messages.end()) {
-		return;
-	}
-
-	sent_messages_map_t& msg_map = it->second;
-	sent_messages_map_t::iterator mit = msg_map.find(uuid.as_string());
-
-	if (mit == msg_map.end()) {
+message_cache_t::move_sent_message_to_new_front(const std::string& route, const wuuid_t& uuid) {
+	dispatch_message_ptr_t msg;
+	if (!m_sent_messages.erase(route, uuid, msg)) {
 		return;
 	}
 
-	boost::shared_ptr<message_iface> msg = mit->second;
-
 	if (!msg) {
 		throw internal_error("empty cached message object at " + std::string(BOOST_CURRENT_FUNCTION));
 	}
 
-	msg_map.erase(mit);
+	cancel_ack_timer(msg);
 	m_new_messages->push_front(msg);
 }
 
 void
-message_cache_t::remove_message_from_cache(const std::string& route, wuuid_t& uuid) {
-	boost::mutex::scoped_lock lock(m_mutex);
+message_cache_t::remove_message_from_cache(const std::string& route, const wuuid_t& uuid) {
+	dispatch_message_ptr_t msg;
+	if (m_sent_messages.erase(route, uuid, msg)) {
+		cancel_timers(msg);
+	}
+}
 
-	route_sent_messages_map_t::iterator it = m_sent_messages.find(route);
+void
+message_cache_t::make_all_messages_new() {
+	drain_intake();
 
-	if (it == m_sent_messages.end()) {
-		return;
+	message_queue_t sent_messages;
+	m_sent_messages.extract_all(sent_messages);
+
+	for (message_queue_t::iterator it = sent_messages.begin(); it != sent_messages.end(); ++it) {
+		if (!*it) {
+			throw internal_error("empty cached message object at " + std::string(BOOST_CURRENT_FUNCTION));
+		}
+
+		cancel_ack_timer(*it);
+		m_new_messages->push_front(*it);
 	}
 
-	sent_messages_map_t& msg_map = it->second;
-	sent_messages_map_t::iterator mit = msg_map.find(uuid.as_string());
+	for (message_queue_t::iterator it = m_new_messages->begin(); it != m_new_messages->end(); ++it) {
+		(*it)->mark_as_sent(false);
+		(*it)->set_ack_received(false);
+	}
 
-	if (mit == msg_map.end()) {
+	m_wakeup.notify();
+}
+
+void
+message_cache_t::make_all_messages_new_for_route(const std::string& route) {
+	message_queue_t sent_messages;
+	m_sent_messages.extract_route(route, sent_messages);
+
+	if (sent_messages.empty()) {
 		return;
 	}
 
-	msg_map.erase(mit);
+	for (message_queue_t::iterator it = sent_messages.begin(); it != sent_messages.end(); ++it) {
+		if (!*it) {
+			throw internal_error("empty cached message object at " + std::string(BOOST_CURRENT_FUNCTION));
+		}
+
+		cancel_ack_timer(*it);
 
-	// check whether route is empty, erase if it is
-	if (msg_map.empty()) {
-		m_sent_messages.erase(it);
+		(*it)->mark_as_sent(false);
+		(*it)->set_ack_received(false);
+		m_new_messages->push_front(*it);
 	}
+
+	m_wakeup.notify();
 }
 
 void
-message_cache_t::make_all_messages_new() {
-	boost::mutex::scoped_lock lock(m_mutex);
-
-	route_sent_messages_map_t::iterator it = m_sent_messages.begin();
-	for (; it != m_sent_messages.end(); ++it) {
+message_cache_t::get_expired_messages(message_queue_t& expired_messages) {
+	drain_intake();
 
-		sent_messages_map_t& msg_map = it->second;
-		sent_messages_map_t::iterator mit = msg_map.begin();
+	assert(m_new_messages);
 
-		for (; mit != msg_map.end(); ++mit) {
+	std::vector<message_timer_t> fired_timers;
+	m_timers.advance(monotonic_clock_t::loop_now(), fired_timers);
 
-			if (!mit->second) {
-				throw internal_error("empty cached message object at " + std::string(BOOST_CURRENT_FUNCTION));
-			}
+	for (size_t i = 0; i < fired_timers.size(); ++i) {
+		const cached_message_ptr_t& msg = fired_timers[i].first;
+		assert(msg);
 
-			mit->second->mark_as_sent(false);
-			mit->second->set_ack_received(false);
-			m_new_messages->push_front(mit->second);
+		if (fired_timers[i].second == MTT_DEADLINE) {
+			msg->set_deadline_timer(invalid_timer_id);
+			msg->mark_as_deadlined();
+		}
+		else {
+			msg->set_ack_timer(invalid_timer_id);
+			msg->mark_as_ack_timedout();
 		}
 
-		msg_map.clear();
+		// both timers of a message might fire at once
+		if (remove_expired_message(msg)) {
+			expired_messages.push_back(msg);
+		}
 	}
+}
 
-	for (message_queue_t::iterator it = m_new_messages->begin(); it != m_new_messages->end(); ++it) {
-		(*it)->mark_as_sent(false);
-		(*it)->set_ack_received(false);
-	}
+void
+message_cache_t::mark_ack_received(const cached_message_ptr_t& message) {
+	message->set_ack_received(true);
+	cancel_ack_timer(message);
+}
+
+long
+message_cache_t::timers_timeout() {
+	return m_timers.next_timeout(monotonic_clock_t::loop_now());
 }
 
 void
-message_cache_t::make_all_messages_new_for_route(const std::string& route) {
-	boost::mutex::scoped_lock lock(m_mutex);
+message_cache_t::arm_deadline_timer(const cached_message_ptr_t& message) {
+	// timer ids left by previous owner of the message are meaningless here
+	message->set_deadline_timer(invalid_timer_id);
 
-	route_sent_messages_map_t::iterator it = m_sent_messages.find(route);
-	if (it == m_sent_messages.end()) {
+	if (message->policy().deadline <= 0.0) {
 		return;
 	}
 
-	sent_messages_map_t& msg_map = it->second;
-	sent_messages_map_t::iterator mit = msg_map.begin();
+	nanoseconds_t expires = message->enqued_at() + monotonic_clock_t::from_seconds(message->policy().deadline);
 
-	if (msg_map.empty()) {
-		return;
-	}
-	
-	for (; mit != msg_map.end(); ++mit) {
-		if (!mit->second) {
-			throw internal_error("empty cached message object at " + std::string(BOOST_CURRENT_FUNCTION));
-		}
+	message->set_deadline_timer(m_timers.arm(expires, std::make_pair(message, MTT_DEADLINE)));
+}
 
-		mit->second->mark_as_sent(false);
-		mit->second->set_ack_received(false);
-		m_new_messages->push_front(mit->second);
-	}
+void
+message_cache_t::arm_ack_timer(const cached_message_ptr_t& message) {
+	nanoseconds_t expires = message->sent_at() + monotonic_clock_t::from_seconds(message->policy().ack_timeout);
 
-	msg_map.clear();
+	message->set_ack_timer(m_timers.arm(expires, std::make_pair(message, MTT_ACK)));
 }
 
-bool
-message_cache_t::is_message_expired(cached_message_ptr_t msg) {
-	return msg->is_expired();
+void
+message_cache_t::cancel_ack_timer(const cached_message_ptr_t& message) {
+	m_timers.cancel(message->ack_timer());
+	message->set_ack_timer(invalid_timer_id);
 }
 
 void
-message_cache_t::get_expired_messages(message_queue_t& expired_messages) {
-	boost::mutex::scoped_lock lock(m_mutex);
+message_cache_t::cancel_timers(const cached_message_ptr_t& message) {
+	cancel_ack_timer(message);
 
-	assert(m_new_messages);
+	m_timers.cancel(message->deadline_timer());
+	message->set_deadline_timer(invalid_timer_id);
+}
 
-	// remove expired from sent
-	route_sent_messages_map_t::iterator it = m_sent_messages.begin();
-	for (; it != m_sent_messages.end(); ++it) {
-
-		sent_messages_map_t& msg_map = it->second;
-		sent_messages_map_t::iterator mit = msg_map.begin();
-
-		while (mit != msg_map.end()) {
-			// get single sent message
-			boost::shared_ptr<message_iface> msg = mit->second;
-			assert(msg);
-
-			// remove expired messages
-			if (msg->is_expired()) {
-				expired_messages.push_back(msg);
-				msg_map.erase(mit++);
-			}
-			else {
-				++mit;
-			}
+bool
+message_cache_t::remove_expired_message(const cached_message_ptr_t& message) {
+	if (message->is_sent()) {
+		if (!m_sent_messages.erase(message->uuid())) {
+			return false;
 		}
 	}
+	else {
+		// only deadline timer is armed for new messages
+		if (!message->is_deadlined()) {
+			return false;
+		}
 
-	// remove expired from new
-	message_queue_t::iterator it2 = m_new_messages->begin();
-	while (it2 != m_new_messages->end()) {
-		// get single pending message
-		boost::shared_ptr<message_iface> msg = *it2;
-		assert(msg);
+		// left in queue and dropped when it reaches front or on compaction,
+		// so mass expiry costs O(expired) rather than a search per message
+		++m_expired_new_messages;
 
-		// remove expired messages
-		if (msg->is_expired()) {
-			expired_messages.push_back(msg);
+		if (m_expired_new_messages * 2 > m_new_messages->size()) {
+			compact_new_messages();
 		}
+	}
+
+	cancel_timers(message);
+	return true;
+}
+
+void
+message_cache_t::skip_expired_new_messages() {
+	while (m_expired_new_messages > 0 && !m_new_messages->empty() && m_new_messages->front()->is_deadlined()) {
+		m_new_messages->pop_front();
+		--m_expired_new_messages;
+	}
+}
 
-		++it2;
+void
+message_cache_t::compact_new_messages() {
+	if (m_expired_new_messages == 0) {
+		return;
 	}
 
-	m_new_messages->erase(std::remove_if(m_new_messages->begin(),
-										 m_new_messages->end(),
-										 &message_cache_t::is_message_expired),
-										 m_new_messages->end());
+	message_queue_t::iterator it = std::remove_if(m_new_messages->begin(),
+												  m_new_messages->end(),
+												  boost::bind(&dispatch_message_t::is_deadlined, _1));
+
+	m_new_messages->erase(it, m_new_messages->end());
+	m_expired_new_messages = 0;
+}
+
+int
+message_cache_t::wakeup_fd() const {
+	return m_wakeup.fd();
+}
+
+void
+message_cache_t::drain_wakeup() {
+	m_wakeup.drain();
 }
 
 void
@@ -399,10 +472,11 @@ message_cache_t::log_stats() {
 
 	log(PLOG_DEBUG, "new messages: %d", m_new_messages->size());
 
-	route_sent_messages_map_t::iterator it = m_sent_messages.begin();
-	for (; it != m_sent_messages.end(); ++it) {
-		sent_messages_map_t& msg_map = it->second;
-		log(PLOG_DEBUG, "sent messages for route: %s, size: %d", it->first.c_str(), msg_map.size());
+	std::vector<std::pair<std::string, size_t> > routes;
+	m_sent_messages.routes_stats(routes);
+
+	for (size_t i = 0; i < routes.size(); ++i) {
+		log(PLOG_DEBUG, "sent messages for route: %s, size: %d", routes[i].first.c_str(), routes[i].second);
 	}
 }
 
@@ -0,0 +1,113 @@
+/*
+    Copyright (c) 2011-2012 Rim Zaidullin <creator@bash.org.ru>
+    Copyright (c) 2011-2012 Other contributors as noted in the AUTHORS file.
+
+    This file is part of Cocaine.
+
+    Cocaine is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Cocaine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>. 
+*/
+
+#include <ctime>
+
+#include "cocaine/dealer/utils/monotonic_clock.hpp"
+
+namespace cocaine {
+namespace dealer {
+
+namespace {
+	// zero while calling thread runs no dispatch loop
+	__thread nanoseconds_t thread_loop_now = 0;
+
+#ifdef CLOCK_MONOTONIC_COARSE
+	volatile int coarse_clock_failed = 0;
+#endif
+}
+
+const nanoseconds_t monotonic_clock_t::nanoseconds_per_millisecond;
+const nanoseconds_t monotonic_clock_t::nanoseconds_per_second;
+
+nanoseconds_t
+monotonic_clock_t::now() {
+	timespec ts;
+
+#ifdef CLOCK_MONOTONIC_COARSE
+	// kernels before 2.6.32 lack coarse clock
+	if (coarse_clock_failed || clock_gettime(CLOCK_MONOTONIC_COARSE, &ts) != 0) {
+		coarse_clock_failed = 1;
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+	}
+#else
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+#endif
+
+	return static_cast<nanoseconds_t>(ts.tv_sec) * nanoseconds_per_second + ts.tv_nsec;
+}
+
+nanoseconds_t
+monotonic_clock_t::loop_now() {
+	if (thread_loop_now == 0) {
+		return now();
+	}
+
+	return thread_loop_now;
+}
+
+nanoseconds_t
+monotonic_clock_t::refresh() {
+	thread_loop_now = now();
+	return thread_loop_now;
+}
+
+nanoseconds_t
+monotonic_clock_t::from_seconds(double seconds) {
+	if (seconds <= 0.0) {
+		return 0;
+	}
+
+	return static_cast<nanoseconds_t>(seconds * nanoseconds_per_second);
+}
+
+double
+monotonic_clock_t::to_seconds(nanoseconds_t interval) {
+	return static_cast<double>(interval) / nanoseconds_per_second;
+}
+
+time_value
+monotonic_clock_t::to_wall_time(nanoseconds_t time) {
+	nanoseconds_t curr_time = now();
+	time_value wall_time = time_value::get_current_time();
+
+	if (time < curr_time) {
+		wall_time -= to_seconds(curr_time - time);
+	}
+
+	return wall_time;
+}
+
+nanoseconds_t
+monotonic_clock_t::from_wall_time(const time_value& time) {
+	nanoseconds_t curr_time = now();
+	time_value wall_time = time_value::get_current_time();
+
+	nanoseconds_t age = 0;
+
+	if (wall_time > time) {
+		age = from_seconds(wall_time.distance(time));
+	}
+
+	return (age < curr_time) ? curr_time - age : 0;
+}
+
+} // namespace dealer
+} // namespace cocaine
@@ -19,6 +19,8 @@
 */
 
 #include <memory>
+#include <algorithm>
+#include <cstdlib>
 
 #include <boost/tuple/tuple.hpp>
 
@@ -278,6 +280,7 @@ overseer_t::update_main_routing_table(routing_table_t& routing_table_update) {
 			}
 			else {
 				new_endpoints_set.insert(main_table_hit->second.begin(), main_table_hit->second.end());
+				apply_weight_hysteresis(new_endpoints_set, main_table_hit->second);
 
 				bool sets_equal = endpoints_set_equal(new_endpoints_set, main_table_hit->second);
 
@@ -414,6 +417,53 @@ overseer_t::endpoints_set_equal(const endpoints_set_t& lhs, const endpoints_set_
 	return true;
 }
 
+void
+overseer_t::apply_weight_hysteresis(endpoints_set_t& fresh, const endpoints_set_t& current) {
+	endpoints_set_t reconciled;
+
+	endpoints_set_t::const_iterator it = fresh.begin();
+	for (; it != fresh.end(); ++it) {
+		cocaine_endpoint_t endpoint = *it;
+		endpoints_set_t::const_iterator cit = current.find(endpoint);
+
+		if (cit != current.end() && !weight_changed(cit->weight, endpoint.weight)) {
+			endpoint.weight = cit->weight;
+		}
+
+		reconciled.insert(endpoint);
+	}
+
+	fresh.swap(reconciled);
+}
+
+bool
+overseer_t::weight_changed(int old_weight, int new_weight) {
+	// endpoint going up or down is always a change
+	if (old_weight <= 0 || new_weight <= 0) {
+		return old_weight != new_weight;
+	}
+
+	// load jitter between heartbeats stays under ~20%
+	return std::abs(new_weight - old_weight) * 5 > old_weight;
+}
+
+int
+overseer_t::endpoint_weight(const cocaine_node_app_info_t& app) {
+	// weight of a single idle slave, leaves room for integer scaling
+	static const double slave_weight = 100.0;
+	static const int max_weight = 1000000;
+
+	// nodes that don't announce slaves still get traffic
+	double capacity = std::max(app.slaves_total, 1u);
+	double idle = (app.slaves_total > app.slaves_busy) ? (app.slaves_total - app.slaves_busy) : 0;
+
+	// work already waiting on node, per slave, plus median slave load
+	double backlog = (app.queue_depth + app.sessions_pending) / capacity + app.load_median;
+
+	double weight = slave_weight * (idle + 1.0) / (backlog + 1.0);
+	return std::max(1, std::min(max_weight, static_cast<int>(weight)));
+}
+
 void
 overseer_t::routing_table_from_responces(const std::map<std::string, cocaine_node_list_t>& parsed_responses,
 										 routing_table_t& routing_table)
@@ -467,7 +517,7 @@ overseer_t::routing_table_from_responces(const std::map<std::string, cocaine_nod
 					break;
 
 				case APP_STATUS_RUNNING:
-					weight = 1;
+					weight = endpoint_weight(app);
 					break;
 
 				case APP_STATUS_STOPPING:
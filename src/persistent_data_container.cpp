@@ -38,20 +38,20 @@ namespace dealer {
 
 persistent_data_container::persistent_data_container() :
 	data_in_memory_(false),
-	data_(NULL),
 	size_(0)
 {
 }
 
 persistent_data_container::persistent_data_container(const void* data, size_t size) :
 	data_in_memory_(false),
-	data_(NULL),
 	size_(0)
 {
 	set_data(data, size);
 }
 
-persistent_data_container::persistent_data_container(const persistent_data_container& dc)
+persistent_data_container::persistent_data_container(const persistent_data_container& dc) :
+	data_in_memory_(false),
+	size_(0)
 {
 	*this = dc;
 }
@@ -70,26 +70,19 @@ persistent_data_container::set_data(const void* data, size_t size) {
 
 	// early exit
 	if (data == NULL || size == 0) {
-		data_ = NULL;
+		buffer_.clear();
 		size_ = 0;
 		return;
 	}
 
 	size_ = size;
-
-	if (size_ > 0) {
-		allocate_memory();
-		memcpy(data_, data, size_);
-	}
+	buffer_.set_data(data, size);
 }
 
 void
 persistent_data_container::unload_data() {
-	if (data_) {
-		delete [] data_;
-		data_ = NULL;
-	}
-
+	// frames still referencing loaded data keep their own copy of the buffer
+	buffer_.clear();
 	data_in_memory_ = false;
 }
 
@@ -99,20 +92,24 @@ persistent_data_container::load_data() {
 		return;
 	}
 
-	assert(data_ == NULL);
+	assert(buffer_.empty());
 
 	// read into allocated memory
 	std::string str = blob_->read(uuid_, EBLOB_COLUMN);
 	size_ = str.size();
-	allocate_memory();
-	memcpy(data_, str.data(), size_);
+	buffer_.set_data(str.data(), size_);
 
 	data_in_memory_ = true;
 }
 
 void*
 persistent_data_container::data() const {
-	return data_;
+	return buffer_.data();
+}
+
+const data_container&
+persistent_data_container::buffer() const {
+	return buffer_;
 }
 
 size_t
@@ -125,27 +122,6 @@ persistent_data_container::empty() const {
 	return (size_ == 0);
 }
 
-void
-persistent_data_container::allocate_memory() {
-	std::string error_msg = "not enough memory to create new data container at ";
-	error_msg += std::string(BOOST_CURRENT_FUNCTION);
-
-	if (size_ == 0) {
-		return;
-	}
-
-	try {
-		data_ = new unsigned char[size_];
-	}
-	catch (...) {
-		throw internal_error(error_msg);
-	}
-
-	if (!data_) {
-		throw internal_error(error_msg);
-	}
-}
-
 void
 persistent_data_container::set_eblob(boost::shared_ptr<eblob_t> blob, const std::string& uuid) {
 	blob_ = blob;
@@ -168,7 +144,7 @@ persistent_data_container::commit_data() {
 		return;
 	}
 
-	blob_->write(uuid_, data_, size_, EBLOB_COLUMN);
+	blob_->write(uuid_, buffer_.data(), size_, EBLOB_COLUMN);
 	//unload_data();
 	//data_in_memory_ = false;
 }
@@ -28,6 +28,7 @@ namespace dealer {
 
 progress_timer::progress_timer() {
     begin_.init_from_current_time();
+    begin_ns_ = monotonic_clock_t::now();
 }
 
 progress_timer::~progress_timer() {
@@ -45,6 +46,7 @@ progress_timer::operator = (const progress_timer& rhs) {
     }
 
     begin_ = rhs.begin_;
+    begin_ns_ = rhs.begin_ns_;
 
     return *this;
 }
@@ -52,18 +54,18 @@ progress_timer::operator = (const progress_timer& rhs) {
 void
 progress_timer::reset() {
 	begin_.init_from_current_time();
+	begin_ns_ = monotonic_clock_t::now();
 }
 
 time_value
 progress_timer::elapsed() {
-	time_value curr_time = time_value::get_current_time();
+	nanoseconds_t curr_time = monotonic_clock_t::now();
 
-	if (begin_ > curr_time) {
+	if (begin_ns_ > curr_time) {
 		return time_value();
 	}
 
-	time_value retval(curr_time.distance(begin_));
-	return retval;
+	return time_value(monotonic_clock_t::to_seconds(curr_time - begin_ns_));
 }
 
 time_value
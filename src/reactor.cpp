@@ -0,0 +1,182 @@
+/*
+    Copyright (c) 2011-2012 Rim Zaidullin <creator@bash.org.ru>
+    Copyright (c) 2011-2012 Other contributors as noted in the AUTHORS file.
+
+    This file is part of Cocaine.
+
+    Cocaine is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Cocaine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>. 
+*/
+
+#include <algorithm>
+
+#include <boost/bind.hpp>
+
+#include "cocaine/dealer/core/reactor.hpp"
+#include "cocaine/dealer/core/handle.hpp"
+#include "cocaine/dealer/utils/monotonic_clock.hpp"
+#include "cocaine/dealer/utils/error.hpp"
+
+namespace cocaine {
+namespace dealer {
+
+reactor_t::reactor_t() :
+	m_is_running(true)
+{
+	m_thread = boost::thread(boost::bind(&reactor_t::run, this));
+}
+
+reactor_t::~reactor_t() {
+	m_is_running = false;
+	m_wakeup.notify();
+	m_thread.join();
+}
+
+void
+reactor_t::attach(handle_t* handle) {
+	boost::mutex::scoped_lock lock(m_mutex);
+	m_attach_requests.push_back(handle);
+	m_wakeup.notify();
+
+	while (std::find(m_attach_requests.begin(), m_attach_requests.end(), handle) != m_attach_requests.end()) {
+		m_cond_var.wait(lock);
+	}
+
+	failed_attaches_t::iterator it = m_failed_attaches.find(handle);
+
+	if (it != m_failed_attaches.end()) {
+		std::string error_msg = "could not start message dispatch, details: " + it->second;
+		m_failed_attaches.erase(it);
+
+		throw internal_error(error_msg);
+	}
+}
+
+void
+reactor_t::detach(handle_t* handle) {
+	boost::mutex::scoped_lock lock(m_mutex);
+	m_detach_requests.push_back(handle);
+	m_wakeup.notify();
+
+	while (std::find(m_detach_requests.begin(), m_detach_requests.end(), handle) != m_detach_requests.end()) {
+		m_cond_var.wait(lock);
+	}
+}
+
+void
+reactor_t::process_requests() {
+	boost::mutex::scoped_lock lock(m_mutex);
+
+	if (m_attach_requests.empty() && m_detach_requests.empty()) {
+		return;
+	}
+
+	// failure is reported to attaching thread, reactor keeps running
+	for (size_t i = 0; i < m_attach_requests.size(); ++i) {
+		try {
+			m_attach_requests[i]->start_dispatch();
+			m_handles.push_back(m_attach_requests[i]);
+		}
+		catch (const std::exception& ex) {
+			m_failed_attaches[m_attach_requests[i]] = ex.what();
+		}
+		catch (...) {
+			m_failed_attaches[m_attach_requests[i]] = "unknown error";
+		}
+	}
+
+	for (size_t i = 0; i < m_detach_requests.size(); ++i) {
+		handles_list_t::iterator it = std::find(m_handles.begin(), m_handles.end(), m_detach_requests[i]);
+
+		if (it != m_handles.end()) {
+			(*it)->stop_dispatch();
+			m_handles.erase(it);
+		}
+	}
+
+	m_attach_requests.clear();
+	m_detach_requests.clear();
+	m_cond_var.notify_all();
+}
+
+void
+reactor_t::run() {
+	while (m_is_running) {
+		process_requests();
+
+		// reactor's own wakeup fd goes first, then fixed amount of items per handle
+		const size_t items_per_handle = handle_t::poll_items_count;
+		m_poll_items.resize(1 + m_handles.size() * items_per_handle);
+
+		m_poll_items[0].socket = NULL;
+		m_poll_items[0].fd = m_wakeup.fd();
+		m_poll_items[0].events = ZMQ_POLLIN;
+		m_poll_items[0].revents = 0;
+
+		// block until the nearest handle timer if there are no events
+		long poll_timeout = -1; // millisec
+
+		for (size_t i = 0; i < m_handles.size(); ++i) {
+			m_handles[i]->fill_poll_items(&m_poll_items[1 + i * items_per_handle]);
+
+			long handle_timeout = m_handles[i]->poll_timeout();
+			if (handle_timeout >= 0 && (poll_timeout < 0 || handle_timeout < poll_timeout)) {
+				poll_timeout = handle_timeout;
+			}
+		}
+
+#if ZMQ_VERSION_MAJOR < 3
+		zmq_poll(&m_poll_items[0], m_poll_items.size(), poll_timeout < 0 ? -1 : poll_timeout * 1000); // microsec
+#else
+		zmq_poll(&m_poll_items[0], m_poll_items.size(), poll_timeout); // millisec
+#endif
+
+		// handles share one clock reading per iteration
+		monotonic_clock_t::refresh();
+
+		if ((ZMQ_POLLIN & m_poll_items[0].revents) == ZMQ_POLLIN) {
+			m_wakeup.drain();
+		}
+
+		// one failing handle must not stop the others sharing reactor
+		handles_list_t failed_handles;
+
+		for (size_t i = 0; i < m_handles.size(); ++i) {
+			try {
+				m_handles[i]->process_poll_items(&m_poll_items[1 + i * items_per_handle]);
+			}
+			catch (const std::exception& ex) {
+				m_handles[i]->abort_dispatch(ex.what());
+				failed_handles.push_back(m_handles[i]);
+			}
+			catch (...) {
+				m_handles[i]->abort_dispatch("unknown error");
+				failed_handles.push_back(m_handles[i]);
+			}
+		}
+
+		for (size_t i = 0; i < failed_handles.size(); ++i) {
+			m_handles.erase(std::find(m_handles.begin(), m_handles.end(), failed_handles[i]));
+		}
+	}
+
+	// handles are expected to detach before reactor dies
+	for (size_t i = 0; i < m_handles.size(); ++i) {
+		m_handles[i]->stop_dispatch();
+	}
+
+	m_handles.clear();
+}
+
+} // namespace dealer
+} // namespace cocaine
@@ -22,15 +22,24 @@
 
 #include "cocaine/dealer/response.hpp"
 #include "cocaine/dealer/core/response_impl.hpp"
+#include "cocaine/dealer/core/response_registry.hpp"
 
 namespace cocaine {
 namespace dealer {
 
-response_t::response_t(const wuuid_t& uuid, const message_path_t& path) {
+response_t::response_t(const wuuid_t& uuid, const message_path_t& path) :
+	m_is_complete(false)
+{
 	m_impl.reset(new response_impl_t(uuid, path));
 }
 
 response_t::~response_t() {
+	boost::shared_ptr<response_registry_t> registry = m_registry.lock();
+
+	if (registry) {
+		registry->remove(m_impl->m_uuid);
+	}
+
 	m_impl.reset();
 }
 
@@ -41,7 +50,73 @@ response_t::get(data_container* data, double timeout) {
 
 void
 response_t::add_chunk(const boost::shared_ptr<response_chunk_t>& chunk) {
-	m_impl->add_chunk(chunk);
+	if (!has_callbacks()) {
+		m_impl->add_chunk(chunk);
+		return;
+	}
+
+	// chunks of one response are delivered by one thread at a time, it is
+	// a reactor thread when there are no callback threads, so callbacks
+	// must not throw through here, same as on callback executor
+	if (m_is_complete) {
+		return;
+	}
+
+	switch (chunk->rpc_code) {
+		case SERVER_RPC_MESSAGE_CHUNK:
+			if (m_on_chunk) {
+				try {
+					m_on_chunk(chunk->data);
+				}
+				catch (...) {
+					// user callback errors must not stop the delivering thread
+				}
+			}
+			break;
+
+		case SERVER_RPC_MESSAGE_CHOKE:
+			m_is_complete = true;
+
+			if (m_on_complete) {
+				try {
+					m_on_complete(0, std::string());
+				}
+				catch (...) {
+					// user callback errors must not stop the delivering thread
+				}
+			}
+			break;
+
+		case SERVER_RPC_MESSAGE_ERROR:
+			m_is_complete = true;
+
+			if (m_on_complete) {
+				try {
+					m_on_complete(chunk->error_code, chunk->error_message);
+				}
+				catch (...) {
+					// user callback errors must not stop the delivering thread
+				}
+			}
+			break;
+
+		default:
+			throw internal_error("response_t received chunk with invalid RPC code: %d", chunk->rpc_code);
+			break;
+	}
+}
+
+void
+response_t::set_callbacks(const response_chunk_callback_t& on_chunk,
+						  const response_complete_callback_t& on_complete)
+{
+	m_on_chunk = on_chunk;
+	m_on_complete = on_complete;
+}
+
+bool
+response_t::has_callbacks() const {
+	return m_on_chunk || m_on_complete;
 }
 
 } // namespace dealer
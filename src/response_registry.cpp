@@ -0,0 +1,121 @@
+/*
+    Copyright (c) 2011-2012 Rim Zaidullin <creator@bash.org.ru>
+    Copyright (c) 2011-2012 Other contributors as noted in the AUTHORS file.
+
+    This file is part of Cocaine.
+
+    Cocaine is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Cocaine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>. 
+*/
+
+#include "cocaine/dealer/core/response_registry.hpp"
+#include "cocaine/dealer/response.hpp"
+
+namespace cocaine {
+namespace dealer {
+
+response_registry_t::response_registry_t() {
+}
+
+response_registry_t::~response_registry_t() {
+}
+
+void
+response_registry_t::add(const wuuid_t& uuid, const response_ptr_t& response) {
+	response->m_registry = shared_from_this();
+
+	entry_t entry;
+	entry.response = response;
+
+	if (response->has_callbacks()) {
+		entry.held_response = response;
+	}
+
+	shard_t& shard = shard_for(uuid);
+	boost::mutex::scoped_lock lock(shard.mutex);
+	shard.responses[uuid] = entry;
+}
+
+void
+response_registry_t::remove(const wuuid_t& uuid) {
+
+	shard_t& shard = shard_for(uuid);
+	boost::mutex::scoped_lock lock(shard.mutex);
+	shard.responses.erase(uuid);
+}
+
+response_registry_t::response_ptr_t
+response_registry_t::response_for(const boost::shared_ptr<response_chunk_t>& chunk) {
+	const wuuid_t& uuid = chunk->uuid;
+	bool finished = (chunk->rpc_code == SERVER_RPC_MESSAGE_CHOKE ||
+					 chunk->rpc_code == SERVER_RPC_MESSAGE_ERROR);
+
+	response_ptr_t response;
+	entry_t erased_entry;
+
+	shard_t& shard = shard_for(uuid);
+	boost::mutex::scoped_lock lock(shard.mutex);
+
+	responses_map_t::iterator it = shard.responses.find(uuid);
+
+	// no response object -> discard chunk
+	if (it == shard.responses.end()) {
+		return response;
+	}
+
+	response = it->second.response.lock();
+
+	// response object was released by caller or is over
+	if (finished || !response) {
+		erased_entry = it->second;
+		shard.responses.erase(it);
+	}
+
+	lock.unlock();
+
+	// response might be destroyed out of shard lock only
+	return response;
+}
+
+size_t
+response_registry_t::size() {
+	size_t responses_count = 0;
+
+	for (size_t i = 0; i < shards_count; ++i) {
+		boost::mutex::scoped_lock lock(m_shards[i].mutex);
+		responses_count += m_shards[i].responses.size();
+	}
+
+	return responses_count;
+}
+
+void
+response_registry_t::pending_uuids(std::vector<wuuid_t>& uuids) {
+	for (size_t i = 0; i < shards_count; ++i) {
+		boost::mutex::scoped_lock lock(m_shards[i].mutex);
+
+		responses_map_t::const_iterator it = m_shards[i].responses.begin();
+		for (; it != m_shards[i].responses.end(); ++it) {
+			uuids.push_back(it->first);
+		}
+	}
+}
+
+response_registry_t::shard_t&
+response_registry_t::shard_for(const wuuid_t& uuid) {
+	// hash mixes all bytes, so ids need not be random
+	return m_shards[uuid.hash() % shards_count];
+}
+
+} // namespace dealer
+} // namespace cocaine
@@ -0,0 +1,275 @@
+/*
+    Copyright (c) 2011-2012 Rim Zaidullin <creator@bash.org.ru>
+    Copyright (c) 2011-2012 Other contributors as noted in the AUTHORS file.
+
+    This file is part of Cocaine.
+
+    Cocaine is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Cocaine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>. 
+*/
+
+#include <cstring>
+
+#include "cocaine/dealer/core/sent_messages_index.hpp"
+
+namespace cocaine {
+namespace dealer {
+
+sent_messages_index_t::sent_messages_index_t() :
+	m_slots(min_capacity),
+	m_size(0),
+	m_deleted(0)
+{
+}
+
+sent_messages_index_t::~sent_messages_index_t() {
+}
+
+size_t
+sent_messages_index_t::size() const {
+	return m_size;
+}
+
+size_t
+sent_messages_index_t::route_size(const std::string& route) const {
+	route_id_t id;
+	if (!find_route(route, id)) {
+		return 0;
+	}
+
+	return m_routes[id].count;
+}
+
+void
+sent_messages_index_t::insert(const std::string& route, const message_ptr_t& message) {
+	// keep load factor (including tombstones) below 3/4
+	if ((m_size + m_deleted + 1) * 4 > m_slots.size() * 3) {
+		size_t capacity = m_slots.size();
+		while ((m_size + 1) * 2 > capacity) {
+			capacity *= 2;
+		}
+
+		rehash(capacity);
+	}
+
+	const unsigned char* uuid = message->uuid().data();
+	size_t index = find_slot(uuid);
+
+	if (index != npos) {
+		remove_slot(index);
+	}
+
+	place(intern_route(route), uuid, message);
+}
+
+bool
+sent_messages_index_t::find(const std::string& route,
+							const wuuid_t& uuid,
+							message_ptr_t& message) const
+{
+	size_t index = find_slot(uuid.data());
+
+	if (index == npos || m_routes[m_slots[index].route].name != route) {
+		return false;
+	}
+
+	message = m_slots[index].message;
+	return true;
+}
+
+bool
+sent_messages_index_t::erase(const std::string& route,
+							 const wuuid_t& uuid,
+							 message_ptr_t& message)
+{
+	size_t index = find_slot(uuid.data());
+
+	if (index == npos || m_routes[m_slots[index].route].name != route) {
+		return false;
+	}
+
+	message = m_slots[index].message;
+	remove_slot(index);
+
+	return true;
+}
+
+bool
+sent_messages_index_t::erase(const wuuid_t& uuid) {
+	size_t index = find_slot(uuid.data());
+
+	if (index == npos) {
+		return false;
+	}
+
+	remove_slot(index);
+	return true;
+}
+
+void
+sent_messages_index_t::routes_stats(std::vector<std::pair<std::string, size_t> >& stats) const {
+	for (size_t i = 0; i < m_routes.size(); ++i) {
+		if (m_routes[i].count > 0) {
+			stats.push_back(std::make_pair(m_routes[i].name, m_routes[i].count));
+		}
+	}
+}
+
+size_t
+sent_messages_index_t::hash(const unsigned char* uuid) {
+	return wuuid_t(uuid).hash();
+}
+
+bool
+sent_messages_index_t::find_route(const std::string& route, route_id_t& id) const {
+	std::map<std::string, route_id_t>::const_iterator it = m_route_ids.find(route);
+
+	if (it == m_route_ids.end()) {
+		return false;
+	}
+
+	id = it->second;
+	return true;
+}
+
+sent_messages_index_t::route_id_t
+sent_messages_index_t::intern_route(const std::string& route) {
+	route_id_t id;
+	if (find_route(route, id)) {
+		return id;
+	}
+
+	// reuse slot of a drained route, routes come and go with workers
+	for (id = 0; id < m_routes.size(); ++id) {
+		if (m_routes[id].count == 0) {
+			m_route_ids.erase(m_routes[id].name);
+			break;
+		}
+	}
+
+	if (id == m_routes.size()) {
+		m_routes.push_back(route_t());
+	}
+
+	m_routes[id].name = route;
+	m_route_ids[route] = id;
+
+	return id;
+}
+
+size_t
+sent_messages_index_t::find_slot(const unsigned char* uuid) const {
+	const size_t mask = m_slots.size() - 1;
+
+	for (size_t i = hash(uuid) & mask; ; i = (i + 1) & mask) {
+		const slot_t& slot = m_slots[i];
+
+		if (slot.state == SLOT_EMPTY) {
+			return npos;
+		}
+
+		if (slot.state == SLOT_FULL && memcmp(slot.uuid, uuid, wuuid_t::UUID_SIZE) == 0) {
+			return i;
+		}
+	}
+}
+
+void
+sent_messages_index_t::place(route_id_t route, const unsigned char* uuid, const message_ptr_t& message) {
+	const size_t mask = m_slots.size() - 1;
+
+	size_t i = hash(uuid) & mask;
+	while (m_slots[i].state == SLOT_FULL) {
+		i = (i + 1) & mask;
+	}
+
+	slot_t& slot = m_slots[i];
+
+	if (slot.state == SLOT_DELETED) {
+		--m_deleted;
+	}
+
+	memcpy(slot.uuid, uuid, wuuid_t::UUID_SIZE);
+	slot.state = SLOT_FULL;
+	slot.route = route;
+	slot.message = message;
+
+	// link at route list head
+	route_t& r = m_routes[route];
+	slot.prev = npos;
+	slot.next = r.head;
+
+	if (r.head != npos) {
+		m_slots[r.head].prev = i;
+	}
+
+	r.head = i;
+	++r.count;
+	++m_size;
+}
+
+void
+sent_messages_index_t::remove_slot(size_t index) {
+	slot_t& slot = m_slots[index];
+	route_t& r = m_routes[slot.route];
+
+	if (slot.prev != npos) {
+		m_slots[slot.prev].next = slot.next;
+	}
+	else {
+		r.head = slot.next;
+	}
+
+	if (slot.next != npos) {
+		m_slots[slot.next].prev = slot.prev;
+	}
+
+	--r.count;
+	--m_size;
+
+	slot.message = message_ptr_t();
+	slot.prev = npos;
+	slot.next = npos;
+
+	// no need for a tombstone in front of an empty slot
+	if (m_slots[(index + 1) & (m_slots.size() - 1)].state == SLOT_EMPTY) {
+		slot.state = SLOT_EMPTY;
+	}
+	else {
+		slot.state = SLOT_DELETED;
+		++m_deleted;
+	}
+}
+
+void
+sent_messages_index_t::rehash(size_t capacity) {
+	std::vector<slot_t> slots(capacity);
+	slots.swap(m_slots);
+
+	m_size = 0;
+	m_deleted = 0;
+
+	for (size_t i = 0; i < m_routes.size(); ++i) {
+		m_routes[i].head = npos;
+		m_routes[i].count = 0;
+	}
+
+	for (size_t i = 0; i < slots.size(); ++i) {
+		if (slots[i].state == SLOT_FULL) {
+			place(slots[i].route, slots[i].uuid, slots[i].message);
+		}
+	}
+}
+
+} // namespace dealer
+} // namespace cocaine
@@ -18,6 +18,10 @@
     along with this program. If not, see <http://www.gnu.org/licenses/>. 
 */
 
+#include <algorithm>
+
+#include <boost/bind.hpp>
+
 #include "cocaine/dealer/core/service.hpp"
 
 namespace cocaine {
@@ -28,22 +32,35 @@ service_t::service_t(const service_info_t& info,
 					 bool logging_enabled) :
 	dealer_object_t(ctx, logging_enabled),
 	m_info(info),
+	m_responses(new response_registry_t),
+	m_callback_executor(ctx->callback_executor()),
 	m_is_running(false),
+	m_deadlines_wakeup(0),
 	m_is_dead(false)
 {
-	// run response_t dispatch thread
 	m_is_running = true;
 
-	m_responces_cleanup_timer.reset();
-
-	// run timed out messages checker
-	m_deadlined_messages_refresher.reset(new refresher(boost::bind(&service_t::check_for_deadlined_messages, this),
-										 deadline_check_interval));
+	// run unhandled messages deadline checker
+	m_deadlines_thread = boost::thread(boost::bind(&service_t::process_deadlines, this));
 }
 
 service_t::~service_t() {
 	m_is_dead = true;
 
+	{
+		boost::mutex::scoped_lock lock(m_unhandled_mutex);
+		m_is_running = false;
+		m_deadlines_cond.notify_one();
+	}
+
+	m_deadlines_thread.join();
+
+	// messages that never reached a handle
+	fail_unhandled_messages();
+
+	// drop handle references held by senders snapshot
+	m_handles_snapshot.store(handles_snapshot_ptr_t());
+
 	// kill handles
 	handles_map_t::iterator it = m_handles.begin();
 	for (;it != m_handles.end(); ++it) {
@@ -57,25 +74,8 @@ service_t::~service_t() {
 		it->second.reset();
 	}
 
-	m_is_running = false;
-
-
-	// detach processed responces
-	{
-		boost::mutex::scoped_lock lock(m_responces_mutex);
-
-		std::map<std::string, boost::shared_ptr<response_t> >::iterator it;
-		it = m_responses.begin();
-
-		while (it != m_responses.end()) {
-			if (it->second.unique()) {
-				m_responses.erase(it++);
-			}
-			else {
-				++it;
-			}
-		}
-	}
+	// handles are gone, nothing else will complete held responses
+	fail_pending_responses();
 
 	log(PLOG_INFO, "FINISHED SERVICE [%s]", m_info.name.c_str());
 }
@@ -96,16 +96,9 @@ service_t::send_message(cached_message_prt_t message) {
 	boost::shared_ptr<response_t> resp;
 	resp.reset(new response_t(message->uuid(), message->path()));
 
-	{
-		boost::mutex::scoped_lock lock(m_responces_mutex);
-		m_responses[message->uuid().as_string()] = resp;
-	}
-
+	m_responses->add(message->uuid(), resp);
 
-	boost::mutex::scoped_lock lock(m_handles_mutex);
-	bool enqued = enque_to_handle(message);
-
-	if (!enqued) {
+	if (!enque_to_handle(message)) {
 		enque_to_unhandled(message);
 	}
 
@@ -113,65 +106,120 @@ service_t::send_message(cached_message_prt_t message) {
 }
 
 void
-service_t::enqueue_responce(boost::shared_ptr<response_chunk_t>& response) {
-	assert(response);
+service_t::send_message(cached_message_prt_t message,
+						const response_chunk_callback_t& on_chunk,
+						const response_complete_callback_t& on_complete)
+{
+	boost::shared_ptr<response_t> resp(new response_t(message->uuid(), message->path()));
+	resp->set_callbacks(on_chunk, on_complete);
 
-	boost::shared_ptr<response_t> response_object;
+	// registry holds response until it is over
+	m_responses->add(message->uuid(), resp);
 
-	{
-		boost::mutex::scoped_lock lock(m_responces_mutex);
+	if (!enque_to_handle(message)) {
+		enque_to_unhandled(message);
+	}
+}
+
+void
+service_t::send_messages(const std::vector<cached_message_prt_t>& messages,
+						 std::vector<boost::shared_ptr<response_t> >& responses)
+{
+	size_t first = responses.size();
+	responses.reserve(first + messages.size());
 
-		std::map<std::string, boost::shared_ptr<response_t> >::iterator it;
+	for (size_t i = 0; i < messages.size(); ++i) {
+		responses.push_back(boost::shared_ptr<response_t>(new response_t(messages[i]->uuid(),
+																		  messages[i]->path())));
+	}
 
-		// check for unique responses and remove them
-		if (m_responces_cleanup_timer.elapsed().as_double() > 1.0f) {
-			it = m_responses.begin();
+	for (size_t i = 0; i < messages.size(); ++i) {
+		m_responses->add(messages[i]->uuid(), responses[first + i]);
+	}
 
-			while (it != m_responses.end()) {
-				if (it->second.unique()) {
-					m_responses.erase(it++);
-				}
-				else {
-					++it;
-				}
-			}
+	// <handle name, messages>
+	std::map<std::string, messages_deque_ptr_t> handle_queues;
 
-			m_responces_cleanup_timer.reset();
+	for (size_t i = 0; i < messages.size(); ++i) {
+		messages_deque_ptr_t& queue = handle_queues[messages[i]->path().handle_name];
+
+		if (!queue) {
+			queue.reset(new cached_messages_deque_t);
 		}
 
-		// find response object for received chunk
-		it = m_responses.find(response->uuid.as_string());
+		queue->push_back(messages[i]);
+	}
+
+	std::map<std::string, messages_deque_ptr_t>::iterator it = handle_queues.begin();
+	for (; it != handle_queues.end(); ++it) {
+		handle_ptr_t handle = find_handle(it->first);
 
-		// no response object -> discard chunk
-		if (it == m_responses.end()) {
-			return;
+		if (handle && handle->assign_message_queue(it->second)) {
+			if (log_flag_enabled(PLOG_DEBUG)) {
+				log(PLOG_DEBUG, "enqued %d messages to existing handle %s",
+					static_cast<int>(it->second->size()), it->first.c_str());
+			}
+			continue;
 		}
 
-		// response object has only one ref -> discard chunk
-		if (it->second.unique()) {
-			return;
+		cached_messages_deque_t::iterator qit = it->second->begin();
+		for (; qit != it->second->end(); ++qit) {
+			enque_to_unhandled(*qit);
 		}
+	}
+}
+
+void
+service_t::enqueue_responce(boost::shared_ptr<response_chunk_t>& response) {
+	assert(response);
+
+	boost::shared_ptr<response_t> response_object = m_responses->response_for(response);
+
+	// no response object -> discard chunk
+	if (!response_object) {
+		return;
+	}
 
-		response_object = it->second;
+	if (response_object->has_callbacks() && m_callback_executor) {
+		// leading bytes of sequential ids are a per-process prefix, so key
+		// on hash of the whole id to spread responses over workers
+		m_callback_executor->post(response->uuid.hash(), boost::bind(&response_t::add_chunk, response_object, response));
+		return;
 	}
 
-	assert(response_object);
 	response_object->add_chunk(response);
 }
 
+service_t::handle_ptr_t
+service_t::find_handle(const std::string& handle_name) const {
+	handles_snapshot_ptr_t handles = m_handles_snapshot.load();
+
+	if (!handles) {
+		return handle_ptr_t();
+	}
+
+	handles_map_t::const_iterator it = handles->find(handle_name);
+	if (it == handles->end()) {
+		return handle_ptr_t();
+	}
+
+	return it->second;
+}
+
+void
+service_t::publish_handles() {
+	m_handles_snapshot.store(handles_snapshot_ptr_t(new handles_map_t(m_handles)));
+}
+
 bool
 service_t::enque_to_handle(const cached_message_prt_t& message) {
-	//boost::mutex::scoped_lock lock(m_handles_mutex);
+	handle_ptr_t handle = find_handle(message->path().handle_name);
 
-	handles_map_t::iterator it = m_handles.find(message->path().handle_name);
-	if (it == m_handles.end()) {
+	// handle is missing or was killed after snapshot was taken
+	if (!handle || !handle->enqueue_message(message)) {
 		return false;
 	}
 
-	handle_ptr_t handle = it->second;
-	assert(handle);
-	handle->enqueue_message(message);
-
 	if (log_flag_enabled(PLOG_DEBUG)) {
 		const static std::string message_str = "enqued msg (%d bytes) with uuid: %s to existing %s (%s)";
 		std::string enqued_timestamp_str = message->enqued_timestamp().as_string();
@@ -191,6 +239,12 @@ void
 service_t::enque_to_unhandled(const cached_message_prt_t& message) {
 	boost::mutex::scoped_lock lock(m_unhandled_mutex);
 
+	// handle might have been published since the caller looked for it,
+	// create_handle() publishes it under m_unhandled_mutex
+	if (enque_to_handle(message)) {
+		return;
+	}
+
 	const std::string& handle_name = message->path().handle_name;
 	unhandled_messages_map_t::iterator it = m_unhandled_messages.find(handle_name);
 	
@@ -206,6 +260,8 @@ service_t::enque_to_unhandled(const cached_message_prt_t& message) {
 		queue->push_back(message);
 	}
 
+	arm_deadline_timer(message);
+
 	if (log_flag_enabled(PLOG_DEBUG)) {
 		const static std::string message_str = "enqued msg (%d bytes) with uuid: %s to unhandled %s (%s)";
 		std::string enqued_timestamp_str = message->enqued_timestamp().as_string();
@@ -219,10 +275,9 @@ service_t::enque_to_unhandled(const cached_message_prt_t& message) {
 	}
 }
 
-boost::shared_ptr<std::deque<boost::shared_ptr<message_iface> > >
+boost::shared_ptr<std::deque<dispatch_message_ptr_t > >
 service_t::get_and_remove_unhandled_queue(const std::string& handle_name) {
-	boost::mutex::scoped_lock lock(m_unhandled_mutex);
-
+	// m_unhandled_mutex is held by caller
 	messages_deque_ptr_t queue(new cached_messages_deque_t);
 
 	unhandled_messages_map_t::iterator it = m_unhandled_messages.find(handle_name);
@@ -233,6 +288,15 @@ service_t::get_and_remove_unhandled_queue(const std::string& handle_name) {
 	queue = it->second;
 	m_unhandled_messages.erase(it);
 
+	// expired messages were answered already
+	compact_unhandled_queue(*queue);
+	m_unhandled_expired.erase(handle_name);
+
+	for (cached_messages_deque_t::iterator qit = queue->begin(); qit != queue->end(); ++qit) {
+		m_unhandled_timers.cancel((*qit)->deadline_timer());
+		(*qit)->set_deadline_timer(invalid_timer_id);
+	}
+
 	return queue;
 }
 
@@ -270,6 +334,10 @@ service_t::append_to_unhandled(const std::string& handle_name,
 	assert(queue);
 	queue->insert(queue->end(), handle_queue->begin(), handle_queue->end());
 
+	for (cached_messages_deque_t::iterator it = handle_queue->begin(); it != handle_queue->end(); ++it) {
+		arm_deadline_timer(*it);
+	}
+
 	// clear metadata
 	for (cached_messages_deque_t::iterator it = queue->begin(); it != queue->end(); ++it) {
 		(*it)->mark_as_sent(false);
@@ -317,12 +385,33 @@ void
 service_t::create_handle(const handle_info_t& handle_info, const std::set<cocaine_endpoint_t>& endpoints) {
 	boost::mutex::scoped_lock lock(m_handles_mutex);
 
-	// create new handle
-	handle_ptr_t handle(new dealer::handle_t(handle_info, endpoints, context()));
+	// create new handle, on failure messages stay in unhandled queue
+	// and expire by their deadlines
+	handle_ptr_t handle;
+
+	try {
+		handle.reset(new dealer::handle_t(handle_info, endpoints, context()));
+	}
+	catch (const std::exception& ex) {
+		log(PLOG_ERROR,
+			"could not create handle %s, details: %s",
+			handle_info.as_string().c_str(),
+			ex.what());
+
+		return;
+	}
+
 	handle->set_responce_callback(boost::bind(&service_t::enqueue_responce, this, _1));
 
-	// retrieve unhandled queue
+	// publish new handle and retrieve unhandled queue at once,
+	// so senders either see the handle or leave message in queue
+	boost::mutex::scoped_lock unhandled_lock(m_unhandled_mutex);
+
+	m_handles[handle_info.name] = handle;
+	publish_handles();
+
 	messages_deque_ptr_t queue = get_and_remove_unhandled_queue(handle_info.name);
+	unhandled_lock.unlock();
 
 	if (!queue->empty()) {
 		handle->assign_message_queue(queue);
@@ -337,9 +426,6 @@ service_t::create_handle(const handle_info_t& handle_info, const std::set<cocain
 			"no unhandled message queue for handle %s",
 			handle_info.as_string().c_str());
 	}
-
-	// append new handle
-	m_handles[handle_info.name] = handle;
 }
 
 void
@@ -376,10 +462,17 @@ service_t::destroy_handle(const handle_info_t& info) {
 
 	log(PLOG_WARNING, "DESTROY HANDLE [%s]", info.name.c_str());
 
+	// hide handle from senders
+	m_handles.erase(it);
+	publish_handles();
+
 	// retrieve message cache and terminate all handle activity
 	handle->kill();
 
 	boost::shared_ptr<message_cache_t> mcache = handle->messages_cache();
+
+	// senders holding older snapshot now fall back to unhandled queue
+	mcache->close_intake();
 	
 	log(PLOG_DEBUG, "messages cache - start");
 	//mcache->log_stats();
@@ -394,74 +487,194 @@ service_t::destroy_handle(const handle_info_t& info) {
 	log(PLOG_DEBUG, "handle_queue size: %d", handle_queue->size());
 
 	append_to_unhandled(info.name, handle_queue);
-
-	m_handles.erase(it);
 	lock.unlock();
 
 	log(PLOG_DEBUG, "DESTROY HANDLE [%s] DONE", info.name.c_str());
 }
 
+void
+service_t::arm_deadline_timer(const cached_message_prt_t& message) {
+	// timer ids left by previous owner of the message are meaningless here
+	message->set_deadline_timer(invalid_timer_id);
+
+	if (message->policy().deadline <= 0.0) {
+		return;
+	}
+
+	nanoseconds_t expires = message->enqued_at() + monotonic_clock_t::from_seconds(message->policy().deadline);
+
+	message->set_deadline_timer(m_unhandled_timers.arm(expires, message));
+
+	// deadline thread sleeps past this one
+	if (expires < m_deadlines_wakeup) {
+		m_deadlines_cond.notify_one();
+	}
+}
+
+void
+service_t::compact_unhandled_queue(cached_messages_deque_t& queue) {
+	cached_messages_deque_t::iterator it = std::remove_if(queue.begin(),
+														  queue.end(),
+														  boost::bind(&dispatch_message_t::is_deadlined, _1));
+	queue.erase(it, queue.end());
+}
+
+void
+service_t::process_deadlines() {
+	boost::mutex::scoped_lock lock(m_unhandled_mutex);
+
+	while (m_is_running) {
+		nanoseconds_t now = monotonic_clock_t::now();
+		long timeout = m_unhandled_timers.next_timeout(now);
+
+		if (timeout == 0) {
+			lock.unlock();
+			check_for_deadlined_messages();
+			lock.lock();
+			continue;
+		}
+
+		// no timers armed, sleep until one is
+		if (timeout < 0) {
+			m_deadlines_wakeup = static_cast<nanoseconds_t>(-1);
+			m_deadlines_cond.wait(lock);
+		}
+		else {
+			m_deadlines_wakeup = now + timeout * monotonic_clock_t::nanoseconds_per_millisecond;
+			m_deadlines_cond.timed_wait(lock, boost::posix_time::milliseconds(timeout));
+		}
+	}
+}
+
 void
 service_t::check_for_deadlined_messages() {
 	boost::mutex::scoped_lock lock(m_unhandled_mutex);
 
-	unhandled_messages_map_t::iterator it = m_unhandled_messages.begin();
+	std::vector<cached_message_prt_t> expired_messages;
+	m_unhandled_timers.advance(monotonic_clock_t::now(), expired_messages);
 
-	for (; it != m_unhandled_messages.end(); ++it) {
-		messages_deque_ptr_t queue = it->second;
+	if (expired_messages.empty()) {
+		return;
+	}
 
-		// create tmp queue
-		messages_deque_ptr_t not_expired_queue(new cached_messages_deque_t);
-		messages_deque_ptr_t expired_queue(new cached_messages_deque_t);
-		bool found_expired = false;
+	// create error response for deadlined message
+	std::string enqued_timestamp_str;
+	std::string sent_timestamp_str;
+	std::string curr_timestamp_str;
 
-		cached_messages_deque_t::iterator qit = queue->begin();
-		for (;qit != queue->end(); ++qit) {
-			if ((*qit)->is_expired() && (*qit)->is_deadlined()) {
-				expired_queue->push_back(*qit);
-				found_expired = true;
-			}
-			else {
-				not_expired_queue->push_back(*qit);
-			}
-		}
+	std::vector<wuuid_t> expired_uuids;
+	expired_uuids.reserve(expired_messages.size());
+
+	for (size_t i = 0; i < expired_messages.size(); ++i) {
+		const cached_message_prt_t& message = expired_messages[i];
+
+		message->set_deadline_timer(invalid_timer_id);
+		message->mark_as_deadlined();
 
-		if (!found_expired) {
+		const std::string& handle_name = message->path().handle_name;
+		unhandled_messages_map_t::iterator it = m_unhandled_messages.find(handle_name);
+		if (it == m_unhandled_messages.end()) {
 			continue;
 		}
 
-		it->second = not_expired_queue;
+		// message stays queued and is dropped on compaction or when queue
+		// goes to a handle, so mass expiry costs O(expired)
+		size_t& expired_count = m_unhandled_expired[handle_name];
+		++expired_count;
 
-		// create error response for deadlined message
-		std::string enqued_timestamp_str;
-		std::string sent_timestamp_str;
-		std::string curr_timestamp_str;
+		if (expired_count * 2 > it->second->size()) {
+			compact_unhandled_queue(*(it->second));
+			expired_count = 0;
+		}
 
-		cached_messages_deque_t::iterator expired_qit = expired_queue->begin();
-		for (;expired_qit != expired_queue->end(); ++expired_qit) {
-			boost::shared_ptr<response_chunk_t> response(new response_chunk_t);
-			response->uuid = (*expired_qit)->uuid();
-			response->rpc_code = SERVER_RPC_MESSAGE_ERROR;
-			response->error_code = deadline_error;
-			response->error_message = "unhandled message expired";
-			enqueue_responce(response);
+		expired_uuids.push_back(message->uuid());
 
-			enqued_timestamp_str = (*expired_qit)->enqued_timestamp().as_string();
-			sent_timestamp_str = (*expired_qit)->sent_timestamp().as_string();
+		if (log_flag_enabled(PLOG_ERROR)) {
+			enqued_timestamp_str = message->enqued_timestamp().as_string();
+			sent_timestamp_str = message->sent_timestamp().as_string();
 			curr_timestamp_str = time_value::get_current_time().as_string();
 
-			if (log_flag_enabled(PLOG_ERROR)) {
-				std::string log_str = "deadline policy exceeded, for unhandled message %s, (enqued: %s, sent: %s, curr: %s)";
+			std::string log_str = "deadline policy exceeded, for unhandled message %s, (enqued: %s, sent: %s, curr: %s)";
 
-				log(PLOG_ERROR,
-					log_str,
-					response->uuid.as_human_readable_string().c_str(),
-					enqued_timestamp_str.c_str(),
-					sent_timestamp_str.c_str(),
-					curr_timestamp_str.c_str());
-			}
+			log(PLOG_ERROR,
+				log_str,
+				message->uuid().as_human_readable_string().c_str(),
+				enqued_timestamp_str.c_str(),
+				sent_timestamp_str.c_str(),
+				curr_timestamp_str.c_str());
+		}
+	}
+
+	// callbacks may run inline and send again to this service
+	lock.unlock();
+
+	for (size_t i = 0; i < expired_uuids.size(); ++i) {
+		enqueue_error(expired_uuids[i], deadline_error, "unhandled message expired");
+	}
+}
+
+void
+service_t::fail_unhandled_messages() {
+	boost::mutex::scoped_lock lock(m_unhandled_mutex);
+
+	std::vector<wuuid_t> uuids;
+
+	unhandled_messages_map_t::iterator it = m_unhandled_messages.begin();
+	for (; it != m_unhandled_messages.end(); ++it) {
+		// expired messages were answered already
+		compact_unhandled_queue(*(it->second));
+
+		cached_messages_deque_t::iterator qit = it->second->begin();
+		for (; qit != it->second->end(); ++qit) {
+			m_unhandled_timers.cancel((*qit)->deadline_timer());
+			(*qit)->set_deadline_timer(invalid_timer_id);
+			uuids.push_back((*qit)->uuid());
 		}
 	}
+
+	m_unhandled_messages.clear();
+	m_unhandled_expired.clear();
+
+	lock.unlock();
+
+	if (!uuids.empty() && log_flag_enabled(PLOG_WARNING)) {
+		log(PLOG_WARNING,
+			"service %s is shutting down, failing %d unhandled messages",
+			m_info.name.c_str(),
+			static_cast<int>(uuids.size()));
+	}
+
+	for (size_t i = 0; i < uuids.size(); ++i) {
+		enqueue_error(uuids[i], resource_error, "service is shutting down");
+	}
+}
+
+void
+service_t::fail_pending_responses() {
+	std::vector<wuuid_t> uuids;
+	m_responses->pending_uuids(uuids);
+
+	if (!uuids.empty() && log_flag_enabled(PLOG_WARNING)) {
+		log(PLOG_WARNING,
+			"service %s is shutting down, failing %d pending responses",
+			m_info.name.c_str(),
+			static_cast<int>(uuids.size()));
+	}
+
+	for (size_t i = 0; i < uuids.size(); ++i) {
+		enqueue_error(uuids[i], resource_error, "service is shutting down");
+	}
+}
+
+void
+service_t::enqueue_error(const wuuid_t& uuid, int error_code, const std::string& error_message) {
+	boost::shared_ptr<response_chunk_t> response(new response_chunk_t);
+	response->uuid = uuid;
+	response->rpc_code = SERVER_RPC_MESSAGE_ERROR;
+	response->error_code = error_code;
+	response->error_message = error_message;
+
+	enqueue_responce(response);
 }
 
 } // namespace dealer
@@ -0,0 +1,92 @@
+/*
+    Copyright (c) 2011-2012 Rim Zaidullin <creator@bash.org.ru>
+    Copyright (c) 2011-2012 Other contributors as noted in the AUTHORS file.
+
+    This file is part of Cocaine.
+
+    Cocaine is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation; either version 3 of the License, or
+    (at your option) any later version.
+
+    Cocaine is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>. 
+*/
+
+#include <cerrno>
+#include <cstring>
+
+#include <unistd.h>
+#include <fcntl.h>
+
+#include <boost/current_function.hpp>
+
+#include "cocaine/dealer/utils/wakeup_fd.hpp"
+#include "cocaine/dealer/utils/error.hpp"
+
+namespace cocaine {
+namespace dealer {
+
+wakeup_fd_t::wakeup_fd_t() :
+	m_pending(0)
+{
+	if (pipe(m_pipe) != 0) {
+		std::string error_str = "could not create wakeup pipe at ";
+		error_str += std::string(BOOST_CURRENT_FUNCTION);
+		error_str += ", error: " + std::string(strerror(errno));
+		throw internal_error(error_str);
+	}
+
+	for (int i = 0; i < 2; ++i) {
+		fcntl(m_pipe[i], F_SETFL, fcntl(m_pipe[i], F_GETFL) | O_NONBLOCK);
+		fcntl(m_pipe[i], F_SETFD, FD_CLOEXEC);
+	}
+}
+
+wakeup_fd_t::~wakeup_fd_t() {
+	close(m_pipe[0]);
+	close(m_pipe[1]);
+}
+
+int
+wakeup_fd_t::fd() const {
+	return m_pipe[0];
+}
+
+void
+wakeup_fd_t::notify() {
+	// only the first notification after a drain touches the pipe
+	if (!__sync_bool_compare_and_swap(&m_pending, 0, 1)) {
+		return;
+	}
+
+	char byte = 1;
+	ssize_t res = 0;
+
+	do {
+		res = write(m_pipe[1], &byte, 1);
+	} while (res < 0 && errno == EINTR);
+}
+
+void
+wakeup_fd_t::drain() {
+	char buffer[64];
+	ssize_t res = 0;
+
+	do {
+		res = read(m_pipe[0], buffer, sizeof(buffer));
+	} while (res > 0 || (res < 0 && errno == EINTR));
+
+	// reset flag after the pipe is empty, producers that enqueued before
+	// this point are visible to the caller, later ones will notify again
+	__sync_lock_release(&m_pending);
+	__sync_synchronize();
+}
+
+} // namespace dealer
+} // namespace cocaine